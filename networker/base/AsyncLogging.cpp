@@ -1,14 +1,30 @@
 #include <stdio.h>
 #include <assert.h>
+#include <sched.h>
 #include <unistd.h>
 #include <functional>
 
 #include "networker/base/AsyncLogging.h"
+#include "networker/base/BinaryLogging.h"
 #include "networker/base/LogFile.h"
 #include "networker/base/Timestamp.h"
 
 using namespace networker;
 
+namespace
+{
+    // 当前线程最近使用的AsyncLogging实例的id和它的Stage
+    __thread int64_t t_stageOwner = 0;
+    __thread void* t_stage = NULL;
+
+    // 积压超过这个字节数时丢弃日志，与原来的25个大缓冲区相同
+    const size_t kMaxPendingBytes = 25 * static_cast<size_t>(kLargeBuffer);
+};
+
+AtomicInt64 AsyncLogging::s_numCreated_;
+const int AsyncLogging::kStageBuffer;
+const int AsyncLogging::kSpareStageBuffers;
+
 AsyncLogging::AsyncLogging(std::string logFileName_, off_t rollSize, int flushInterval)
     :flushInterval_(flushInterval),
     running_(false),
@@ -20,14 +36,105 @@ AsyncLogging::AsyncLogging(std::string logFileName_, off_t rollSize, int flushIn
     currentBuffer_(new Buffer),
     nextBuffer_(new Buffer),
     buffers_(),
-    latch_(1)
+    latch_(1),
+    binary_(false),
+    id_(s_numCreated_.incrementAndGet())
 {
     currentBuffer_->bzero();
     nextBuffer_->bzero();
     buffers_.reserve(16);
+
+    // 预先分配，稳定运行时前端线程换缓冲区不再分配内存
+    for (std::atomic<StageBuffer*>& spare: spareStageBuffers_) {
+        spare.store(new StageBuffer, std::memory_order_relaxed);
+    }
+}
+
+AsyncLogging::~AsyncLogging()
+{
+    if (running_) {
+        stop();
+    }
+
+    for (std::atomic<StageBuffer*>& spare: spareStageBuffers_) {
+        delete spare.load(std::memory_order_relaxed);
+    }
+}
+
+void AsyncLogging::Stage::lock()
+{
+    while (locked_.exchange(true, std::memory_order_acquire)) {
+        sched_yield();
+    }
 }
 
+AsyncLogging::Stage* AsyncLogging::localStage()
+{
+    if (t_stageOwner != id_) {
+        std::unique_ptr<Stage> stage(new Stage);
+        t_stage = stage.get();
+        t_stageOwner = id_;
+        MutexLockGuard lock(mutex_);
+        stages_.push_back(std::move(stage));
+    }
+    return static_cast<Stage*>(t_stage);
+}
+
+/**
+ * 只锁当前线程自己的Stage，暂存缓冲区写满时才把它放进无锁队列，并短暂地拿mutex_唤醒后端线程
+ * 一个线程交替使用多个AsyncLogging实例时，每次切换都会注册一个新的Stage，因此通常一个进程只用一个实例
+ */
 void AsyncLogging::append(const char* logline, int len)
+{
+    if (!binary_) {
+        if (len >= kStageBuffer) {
+            appendLocked(logline, len);
+        } else {
+            appendStaged(NULL, 0, logline, len);
+        }
+        return;
+    }
+
+    // 二进制模式下文本日志是site为NULL的记录
+    binlog::RecordHeader header = { NULL, 0, 0, static_cast<uint32_t>(len) };
+    if (len + static_cast<int>(sizeof header) >= kStageBuffer) {
+        appendLocked(logline, len);
+    } else {
+        appendStaged(reinterpret_cast<const char*>(&header), sizeof header, logline, len);
+    }
+}
+
+void AsyncLogging::appendBinary(const char* record, int len)
+{
+    assert(binary_);
+    assert(len < kStageBuffer);
+    appendStaged(NULL, 0, record, len);
+}
+
+void AsyncLogging::appendStaged(const char* prefix, int prefixLen, const char* data, int len)
+{
+    Stage* stage = localStage();
+    bool full = false;
+    stage->lock();
+    if (stage->buffer_->avail() <= prefixLen + len) {
+        stagedBuffers_.push(std::move(stage->buffer_));
+        stage->buffer_ = takeSpareStageBuffer();
+        full = true;
+    }
+    if (prefixLen > 0) {
+        stage->buffer_->append(prefix, prefixLen);
+    }
+    stage->buffer_->append(data, len);
+    stage->unlock();
+
+    if (full) {
+        // 后端线程在mutex_内检查队列后才等待，所以这里不会丢失唤醒
+        MutexLockGuard lock(mutex_);
+        cond_.notify();
+    }
+}
+
+void AsyncLogging::appendLocked(const char* logline, int len)
 {
     MutexLockGuard lock(mutex_);
     if (currentBuffer_->avail() > len) {
@@ -65,6 +172,9 @@ void AsyncLogging::threadFunc()
     BufferVector buffersToWrite;
     buffersToWrite.reserve(16);
 
+    // 各个前端线程的暂存缓冲区
+    std::vector<StageBufferPtr> stagedToWrite;
+
     while (running_) {
         assert(newBuffer1 && newBuffer1->length() == 0);
         assert(newBuffer2 && newBuffer2->length() == 0);
@@ -74,7 +184,7 @@ void AsyncLogging::threadFunc()
         {
             MutexLockGuard lock(mutex_);
             // 暂时无日志，现在进行休眠等待
-            if (buffers_.empty()) {
+            if (buffers_.empty() && stagedBuffers_.empty()) {
                 cond_.waitForSeconds(flushInterval_);
             }
 
@@ -96,10 +206,17 @@ void AsyncLogging::threadFunc()
 
         assert(!buffersToWrite.empty());
 
+        // 已写满的暂存缓冲区，以及刷新周期到了还没有写满的
+        collectStages();
+        StageBufferPtr staged;
+        while (stagedBuffers_.pop(&staged)) {
+            stagedToWrite.push_back(std::move(staged));
+        }
+
         // buffersToWrite 超出25
         if (buffersToWrite.size() > 25) {
             char buf[256];
-            snprintf(buf, sizeof(buf), "Drooped log message at %s, %zd larger buffer\n",
+            snprintf(buf, sizeof(buf), "Drooped log message at %s, %zu larger buffer\n",
                 Timestamp::now().toFormattedString().c_str(), buffersToWrite.size() - 2);
             fputs(buf, stderr);
             output.append(buf, static_cast<int>(strlen(buf)));
@@ -108,11 +225,44 @@ void AsyncLogging::threadFunc()
             buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
         }
 
+        // 暂存缓冲区同样最多积压25个大缓冲区的字节数，超出时只保留前两个大缓冲区的量
+        size_t stagedBytes = 0;
+        for (const StageBufferPtr& buffer: stagedToWrite) {
+            stagedBytes += buffer->length();
+        }
+        if (stagedBytes > kMaxPendingBytes) {
+            size_t kept = 0;
+            size_t keep = 0;
+            while (keep < stagedToWrite.size() && kept + stagedToWrite[keep]->length() <= 2 * static_cast<size_t>(kLargeBuffer)) {
+                kept += stagedToWrite[keep]->length();
+                ++keep;
+            }
+
+            char buf[256];
+            snprintf(buf, sizeof(buf), "Dropped log messages at %s, %zu bytes from %zu thread buffers\n",
+                Timestamp::now().toFormattedString().c_str(), stagedBytes - kept, stagedToWrite.size() - keep);
+            fputs(buf, stderr);
+            output.append(buf, static_cast<int>(strlen(buf)));
+
+            stagedToWrite.resize(keep);
+        }
+
         // 将已经写满的 Buffer 写入到日志文件中，由LogFile 进行IO操作
         for (size_t i = 0; i < buffersToWrite.size(); ++i) {
             output.append(buffersToWrite[i]->data(), buffersToWrite[i]->length());
         }
 
+        for (StageBufferPtr& buffer: stagedToWrite) {
+            if (binary_) {
+                writeRecords(&output, *buffer);
+            } else {
+                output.append(buffer->data(), buffer->length());
+            }
+            // 还给前端线程和collectStages，槽位满时释放
+            putSpareStageBuffer(std::move(buffer));
+        }
+        stagedToWrite.clear();
+
         // 如果 buffersToWrite 大于 2，重置 buffersToWrite的长度为2.用于清空使用的两个缓存
         if (buffersToWrite.size() > 2) {
             buffersToWrite.resize(2);
@@ -136,4 +286,93 @@ void AsyncLogging::threadFunc()
         output.flush();
     }
     output.flush();
-}
\ No newline at end of file
+}
+
+/**
+ * 拿一个空的暂存缓冲区交换每个Stage中还没有写满的缓冲区，放进stagedBuffers_
+ * 与前端线程一样在Stage的锁内入队，因此同一个线程的缓冲区在队列中保持先后顺序
+ * 每个Stage只在交换指针时被锁住，所属线程最多等待这一瞬间
+ */
+void AsyncLogging::collectStages()
+{
+    std::vector<Stage*> stages;
+    {
+        MutexLockGuard lock(mutex_);
+        stages.reserve(stages_.size());
+        for (const std::unique_ptr<Stage>& stage: stages_) {
+            stages.push_back(stage.get());
+        }
+    }
+
+    StageBufferPtr fresh;
+    for (Stage* stage: stages) {
+        if (!fresh) {
+            fresh = takeSpareStageBuffer();
+        }
+
+        stage->lock();
+        if (stage->buffer_->length() > 0) {
+            stage->buffer_.swap(fresh);
+            stagedBuffers_.push(std::move(fresh));
+        }
+        stage->unlock();
+    }
+
+    if (fresh) {
+        putSpareStageBuffer(std::move(fresh));
+    }
+}
+
+AsyncLogging::StageBufferPtr AsyncLogging::takeSpareStageBuffer()
+{
+    for (std::atomic<StageBuffer*>& spare: spareStageBuffers_) {
+        if (spare.load(std::memory_order_relaxed) != NULL) {
+            StageBuffer* buffer = spare.exchange(NULL, std::memory_order_acquire);
+            if (buffer != NULL) {
+                return StageBufferPtr(buffer);
+            }
+        }
+    }
+    return StageBufferPtr(new StageBuffer);
+}
+
+void AsyncLogging::putSpareStageBuffer(StageBufferPtr buffer)
+{
+    buffer->reset();
+    for (std::atomic<StageBuffer*>& spare: spareStageBuffers_) {
+        StageBuffer* expected = NULL;
+        if (spare.load(std::memory_order_relaxed) == NULL
+            && spare.compare_exchange_strong(expected, buffer.get(), std::memory_order_release, std::memory_order_relaxed)) {
+            buffer.release();
+            return;
+        }
+    }
+}
+
+/**
+ * 文本记录直接写入，二进制记录格式化之后写入
+ * 记录都是前端线程完整写入的，遇到不完整的记录说明缓冲区已经损坏，丢弃剩下的部分
+ */
+void AsyncLogging::writeRecords(LogFile* output, const StageBuffer& buffer)
+{
+    LogStream stream;
+    const char* p = buffer.data();
+    const char* end = p + buffer.length();
+    while (end - p >= static_cast<ptrdiff_t>(sizeof(binlog::RecordHeader))) {
+        binlog::RecordHeader header;
+        memcpy(&header, p, sizeof header);
+        int recordLen = static_cast<int>(sizeof header + header.argBytes);
+        if (recordLen > end - p) {
+            break;
+        }
+
+        if (header.site == NULL) {
+            output->append(p + sizeof header, static_cast<int>(header.argBytes));
+        } else {
+            stream.resetBuffer();
+            binlog::formatRecord(p, recordLen, &stream);
+            output->append(stream.buffer().data(), stream.buffer().length());
+        }
+        p += recordLen;
+    }
+}
@@ -1,17 +1,35 @@
 #ifndef NETWORKER_BASE_ASYNCLOGGING_H
 #define NETWORKER_BASE_ASYNCLOGGING_H
 
+#include <assert.h>
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "networker/base/Atomic.h"
 #include "networker/base/CountDownLatch.h"
+#include "networker/base/MpscQueue.h"
 #include "networker/base/MutexLock.h"
 #include "networker/base/Thread.h"
 #include "networker/base/LogStream.h"
 
 namespace networker
 {
+    class LogFile;
+
+    /**
+     * 异步日志，前端线程只把日志追加到缓冲区，由后端线程写入LogFile
+     *
+     * 每个前端线程有一个自己的暂存缓冲区(Stage)，append只锁自己的Stage，不同线程之间不竞争
+     * 暂存缓冲区写满时通过无锁的MpscQueue交给后端线程，没有写满的在每个刷新周期由后端线程取走
+     * 同一个线程的日志保持顺序，不同线程的日志按交给后端的先后写入，一个刷新周期之内可能不是按时间排序
+     *
+     * 超过暂存缓冲区大小的日志仍然走原来的currentBuffer_/nextBuffer_双缓冲
+     *
+     * enableBinaryRecords()之后暂存缓冲区中保存binlog::RecordHeader开头的记录，二进制日志由后端线程格式化成文本
+     */
     class AsyncLogging: noncopyable
     {
         public:
@@ -19,6 +37,15 @@ namespace networker
             typedef FixedBuffer<kLargeBuffer> Buffer;
             typedef std::vector<std::shared_ptr<Buffer>> BufferVector;
             typedef std::shared_ptr<Buffer> BufferPtr;
+
+            // 每个前端线程的暂存缓冲区大小
+            static const int kStageBuffer = 64 * 1024;
+            typedef FixedBuffer<kStageBuffer> StageBuffer;
+            typedef std::unique_ptr<StageBuffer> StageBufferPtr;
+
+            // 后端线程回收给前端线程的空暂存缓冲区的最大数量
+            static const int kSpareStageBuffers = 8;
+
             const int flushInterval_;
             bool running_;
             std::string basename_;
@@ -36,18 +63,67 @@ namespace networker
             // 待写入文件已经填满的缓冲，供后端写入的Buffer
             BufferVector buffers_;
             CountDownLatch latch_;
-        public:
-            AsyncLogging(const std::string basename, off_t rollSize, int flushInterval = 3);
 
-            ~AsyncLogging() 
+        private:
+            /**
+             * 一个前端线程的暂存缓冲区，只有所属的线程和后端线程会访问
+             * locked_是自旋锁，后端线程每个刷新周期只持有它交换一次指针，所属线程几乎总是无竞争地拿到
+             */
+            struct Stage
             {
-                if (running_) {
-                    stop();
+                std::atomic<bool> locked_;
+                StageBufferPtr buffer_;
+
+                Stage(): locked_(false), buffer_(new StageBuffer)
+                {
                 }
-            }
+
+                void lock();
+
+                void unlock()
+                {
+                    locked_.store(false, std::memory_order_release);
+                }
+            };
+
+            // 暂存缓冲区中是否是带记录头的记录
+            bool binary_;
+
+            // 区分先后创建在同一地址上的AsyncLogging，线程局部的Stage指针只对id_相同的实例有效
+            const int64_t id_;
+
+            // 由mutex_保护，线程退出后它的Stage留到AsyncLogging析构时释放
+            std::vector<std::unique_ptr<Stage>> stages_;
+
+            // 交给后端线程的暂存缓冲区: 前端线程写满的，以及collectStages取走的还没有写满的
+            MpscQueue<StageBufferPtr> stagedBuffers_;
+
+            /**
+             * 后端线程回收的空暂存缓冲区，前端线程写满时从这里取，不在IO线程中分配64KB的新缓冲区
+             * 固定数量的槽位，放入的一方用compare_exchange占一个空槽，取出的一方用exchange把槽位置空，没有ABA问题
+             * 都取空了(启动时或者突发的大量日志)才new
+             */
+            std::atomic<StageBuffer*> spareStageBuffers_[kSpareStageBuffers];
+
+            static AtomicInt64 s_numCreated_;
+
+        public:
+            AsyncLogging(const std::string basename, off_t rollSize, int flushInterval = 3);
+
+            ~AsyncLogging();
 
             void append(const char* logline, int len);
 
+            // 一条binlog::RecordWriter编码的记录，只能在enableBinaryRecords()之后使用
+            void appendBinary(const char* record, int len);
+
+            // 必须在start()之前调用
+            void enableBinaryRecords()
+            {
+                assert(!running_);
+                binary_ = true;
+            }
+
             void start()
             {
                 running_ = true;
@@ -57,12 +133,37 @@ namespace networker
 
             void stop() {
                 running_ = false;
-                cond_.notify();
+                {
+                    MutexLockGuard lock(mutex_);
+                    cond_.notify();
+                }
                 thread_.join();
             }
+
+        private:
+            // 原来的双缓冲路径
+            void appendLocked(const char* logline, int len);
+
+            // 把prefix和data连续地写进当前线程的暂存缓冲区，两者的长度之和必须小于kStageBuffer
+            void appendStaged(const char* prefix, int prefixLen, const char* data, int len);
+
+            // 后端线程把一个带记录头的暂存缓冲区转成文本写入文件
+            void writeRecords(LogFile* output, const StageBuffer& buffer);
+
+            // 当前线程在这个实例中的Stage，第一次调用时注册
+            Stage* localStage();
+
+            // 后端线程把所有暂存缓冲区中的数据放进stagedBuffers_
+            void collectStages();
+
+            // 取一个空暂存缓冲区，没有时new一个，任意线程
+            StageBufferPtr takeSpareStageBuffer();
+
+            // 清空buffer并放回spareStageBuffers_，槽位满时释放
+            void putSpareStageBuffer(StageBufferPtr buffer);
     };
 
 };
 
 
-#endif
\ No newline at end of file
+#endif
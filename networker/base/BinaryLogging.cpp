@@ -0,0 +1,182 @@
+#include "networker/base/BinaryLogging.h"
+
+using namespace networker;
+using namespace networker::binlog;
+
+namespace
+{
+    void defaultOutput(const char* record, int len)
+    {
+        LogStream stream;
+        if (formatRecord(record, len, &stream) > 0) {
+            Logger::outputFunc()(stream.buffer().data(), stream.buffer().length());
+        }
+    }
+
+    OutputFunc g_binaryOutput = defaultOutput;
+
+    template<typename V>
+    bool readValue(const char** p, const char* end, V* v)
+    {
+        if (end - *p < static_cast<ptrdiff_t>(sizeof *v)) {
+            return false;
+        }
+        memcpy(v, *p, sizeof *v);
+        *p += sizeof *v;
+        return true;
+    }
+
+    // 解码一个参数写到stream，参数区结束或者数据损坏时返回false
+    bool formatArg(const char** p, const char* end, LogStream* stream)
+    {
+        if (*p >= end) {
+            return false;
+        }
+
+        ArgType type = static_cast<ArgType>(*(*p)++);
+        switch (type) {
+            case kBool: {
+                uint8_t v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << (v != 0);
+                return true;
+            }
+            case kChar: {
+                char v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << v;
+                return true;
+            }
+            case kInt32: {
+                int32_t v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << v;
+                return true;
+            }
+            case kUInt32: {
+                uint32_t v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << v;
+                return true;
+            }
+            case kInt64: {
+                int64_t v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << v;
+                return true;
+            }
+            case kUInt64: {
+                uint64_t v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << v;
+                return true;
+            }
+            case kDouble: {
+                double v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << v;
+                return true;
+            }
+            case kPointer: {
+                uintptr_t v;
+                if (!readValue(p, end, &v)) {
+                    return false;
+                }
+                *stream << reinterpret_cast<const void*>(v);
+                return true;
+            }
+            case kString: {
+                uint16_t n;
+                if (!readValue(p, end, &n) || end - *p < n) {
+                    return false;
+                }
+                stream->append(*p, n);
+                *p += n;
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+void binlog::setOutput(OutputFunc out)
+{
+    g_binaryOutput = out;
+}
+
+void RecordWriter::finish()
+{
+    RecordHeader header;
+    header.site = site_;
+    header.microSecondsSinceEpoch = (g_logCoarseClock ? Timestamp::nowCoarse() : Timestamp::now()).microSecondsSinceEpoch();
+    header.tid = CurrentThread::tid();
+    header.argBytes = static_cast<uint32_t>(cur_ - buf_ - sizeof header);
+    memcpy(buf_, &header, sizeof header);
+    g_binaryOutput(buf_, static_cast<int>(cur_ - buf_));
+}
+
+/**
+ * 依次输出格式串中"{}"之间的文字和对应的参数，参数用完后剩下的格式串原样输出，多出的参数以空格分隔追加在末尾
+ */
+int binlog::formatRecord(const char* data, int len, LogStream* stream)
+{
+    RecordHeader header;
+    if (len < static_cast<int>(sizeof header)) {
+        return 0;
+    }
+    memcpy(&header, data, sizeof header);
+    if (header.argBytes > static_cast<uint32_t>(len) - sizeof header) {
+        return 0;
+    }
+
+    const char* p = data + sizeof header;
+    const char* end = p + header.argBytes;
+    int recordLen = static_cast<int>(sizeof header + header.argBytes);
+
+    // 前端已经格式化好的文本
+    if (header.site == NULL) {
+        stream->append(p, static_cast<int>(header.argBytes));
+        return recordLen;
+    }
+
+    const LogSite* site = header.site;
+    Logger::formatHeader(*stream, Timestamp(header.microSecondsSinceEpoch), header.tid, site->level);
+    if (site->level <= Logger::DEBUG) {
+        *stream << site->function << ' ';
+    }
+
+    const char* format = site->format;
+    bool more = true;
+    while (const char* holder = strstr(format, "{}")) {
+        stream->append(format, static_cast<int>(holder - format));
+        format = holder + 2;
+        more = more && formatArg(&p, end, stream);
+        if (!more) {
+            stream->append("{}", 2);
+        }
+    }
+    *stream << format;
+
+    while (more && p < end) {
+        *stream << ' ';
+        more = formatArg(&p, end, stream);
+    }
+
+    const char* slash = strrchr(site->file, '/');
+    *stream << " - " << (slash ? slash + 1 : site->file) << ':' << site->line << '\n';
+    return recordLen;
+}
@@ -0,0 +1,242 @@
+#ifndef NETWORKER_BASE_BINARYLOGGING_H
+#define NETWORKER_BASE_BINARYLOGGING_H
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+
+#include "networker/base/CurrentThread.h"
+#include "networker/base/Logging.h"
+#include "networker/base/StringPiece.h"
+
+namespace networker
+{
+namespace binlog
+{
+    /**
+     * 二进制日志: 前端线程不格式化，只把调用点和参数的原始字节写成一条记录，由日志线程(AsyncLogging)转成文本
+     *
+     * LOG_BIN_INFO("accept {} from {}, total {}", fd, peer, n);
+     *
+     * 格式串中的"{}"依次替换为参数，参数比"{}"多时追加在末尾，格式串必须是字符串字面量
+     * 整数、浮点数和指针按原始字节保存，字符串拷贝内容(超过kMaxRecord时截断)
+     * 输出的文本与LOG_*相同，只是TRACE/DEBUG的函数名来自调用点
+     */
+
+    // 一个日志调用点，静态存储，它的地址就是记录中的调用点ID，因此只能在同一个进程中解码
+    struct LogSite
+    {
+        Logger::LogLevel level;
+        const char* file;
+        int line;
+        const char* function;
+        const char* format;
+    };
+
+    // 记录头，后面跟着argBytes字节的参数
+    struct RecordHeader
+    {
+        const LogSite* site;            // NULL表示后面是一行已经格式化好的文本
+        int64_t microSecondsSinceEpoch;
+        int32_t tid;
+        uint32_t argBytes;
+    };
+
+    enum ArgType
+    {
+        kBool,
+        kChar,
+        kInt32,
+        kUInt32,
+        kInt64,
+        kUInt64,
+        kDouble,
+        kPointer,
+        kString,        // 后面是uint16_t的长度和内容
+    };
+
+    // 一条记录(含记录头)的最大字节数
+    const int kMaxRecord = 1024;
+
+    // 输出一条完整的记录，例如AsyncLogging::appendBinary
+    typedef void (*OutputFunc)(const char* record, int len);
+
+    /**
+     * 默认在调用线程中格式化并交给Logger::outputFunc()，没有省下格式化的开销，只保证不丢日志
+     * 在程序启动时设置
+     */
+    void setOutput(OutputFunc);
+
+    /**
+     * 把一条记录格式化成一行文本，追加到stream
+     * 返回这条记录的字节数，数据不完整时返回0
+     */
+    int formatRecord(const char* data, int len, LogStream* stream);
+
+    // 在栈上编码一条记录
+    class RecordWriter: noncopyable
+    {
+        private:
+            char buf_[kMaxRecord];
+            char* cur_;
+            const LogSite* site_;
+
+        public:
+            explicit RecordWriter(const LogSite* site): cur_(buf_ + sizeof(RecordHeader)), site_(site)
+            {
+            }
+
+            void put(bool v)
+            {
+                putValue(kBool, static_cast<uint8_t>(v));
+            }
+
+            void put(char v)
+            {
+                putValue(kChar, v);
+            }
+
+            void put(short v)
+            {
+                putValue(kInt32, static_cast<int32_t>(v));
+            }
+
+            void put(unsigned short v)
+            {
+                putValue(kUInt32, static_cast<uint32_t>(v));
+            }
+
+            void put(int v)
+            {
+                putValue(kInt32, static_cast<int32_t>(v));
+            }
+
+            void put(unsigned int v)
+            {
+                putValue(kUInt32, static_cast<uint32_t>(v));
+            }
+
+            void put(long v)
+            {
+                putValue(kInt64, static_cast<int64_t>(v));
+            }
+
+            void put(unsigned long v)
+            {
+                putValue(kUInt64, static_cast<uint64_t>(v));
+            }
+
+            void put(long long v)
+            {
+                putValue(kInt64, static_cast<int64_t>(v));
+            }
+
+            void put(unsigned long long v)
+            {
+                putValue(kUInt64, static_cast<uint64_t>(v));
+            }
+
+            void put(float v)
+            {
+                putValue(kDouble, static_cast<double>(v));
+            }
+
+            void put(double v)
+            {
+                putValue(kDouble, v);
+            }
+
+            void put(long double v)
+            {
+                putValue(kDouble, static_cast<double>(v));
+            }
+
+            void put(const void* v)
+            {
+                putValue(kPointer, reinterpret_cast<uintptr_t>(v));
+            }
+
+            void put(const char* str)
+            {
+                if (str) {
+                    putString(str, strlen(str));
+                } else {
+                    putString("(null)", 6);
+                }
+            }
+
+            void put(const std::string& str)
+            {
+                putString(str.data(), str.size());
+            }
+
+            void put(StringPiece str)
+            {
+                putString(str.data(), static_cast<size_t>(str.size()));
+            }
+
+            // 填写记录头并交给输出函数
+            void finish();
+
+        private:
+            template<typename V>
+            void putValue(ArgType type, V v)
+            {
+                if (avail() >= 1 + sizeof v) {
+                    *cur_++ = static_cast<char>(type);
+                    memcpy(cur_, &v, sizeof v);
+                    cur_ += sizeof v;
+                }
+            }
+
+            void putString(const char* str, size_t len)
+            {
+                if (avail() < 1 + sizeof(uint16_t)) {
+                    return;
+                }
+                len = std::min(len, avail() - 1 - sizeof(uint16_t));
+                uint16_t n = static_cast<uint16_t>(len);
+                *cur_++ = static_cast<char>(kString);
+                memcpy(cur_, &n, sizeof n);
+                cur_ += sizeof n;
+                memcpy(cur_, str, len);
+                cur_ += len;
+            }
+
+            size_t avail() const
+            {
+                return static_cast<size_t>(buf_ + sizeof buf_ - cur_);
+            }
+    };
+
+    template<typename... Args>
+    void log(const LogSite* site, const Args&... args)
+    {
+        RecordWriter writer(site);
+        (writer.put(args), ...);
+        writer.finish();
+    }
+
+};
+
+    #define NETWORKER_LOG_BIN(level, fmt, ...) do { \
+        if (__builtin_expect(NETWORKER_LOG_ENABLED(level), 0)) { \
+            static const ::networker::binlog::LogSite logSite = { level, __FILE__, __LINE__, __func__, fmt }; \
+            ::networker::binlog::log(&logSite, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+    // 二进制日志打印宏，没有FATAL，需要立即输出并终止程序时使用LOG_FATAL
+    #define LOG_BIN_TRACE(fmt, ...) NETWORKER_LOG_BIN(Logger::TRACE, fmt, ##__VA_ARGS__)
+
+    #define LOG_BIN_DEBUG(fmt, ...) NETWORKER_LOG_BIN(Logger::DEBUG, fmt, ##__VA_ARGS__)
+
+    #define LOG_BIN_INFO(fmt, ...) NETWORKER_LOG_BIN(Logger::INFO, fmt, ##__VA_ARGS__)
+
+    #define LOG_BIN_WARN(fmt, ...) NETWORKER_LOG_BIN(Logger::WARN, fmt, ##__VA_ARGS__)
+
+    #define LOG_BIN_ERROR(fmt, ...) NETWORKER_LOG_BIN(Logger::ERROR, fmt, ##__VA_ARGS__)
+};
+
+#endif
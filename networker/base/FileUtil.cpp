@@ -96,8 +96,6 @@ int ReadSmallFile::readToString(int maxSize, String *content, int64_t *fileSize,
             if (createTime) {
                 *createTime = statbuf.st_ctime;
             }
-        } else {
-            err = errno;
         }
 
         while (content->size() < implicit_cast<size_t>(maxSize)) {
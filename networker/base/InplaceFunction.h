@@ -0,0 +1,243 @@
+#ifndef NETWORKER_BASE_INPLACEFUNCTION_H
+#define NETWORKER_BASE_INPLACEFUNCTION_H
+
+#include <assert.h>
+#include <functional>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace networker
+{
+    template<typename Signature, size_t Capacity = 64>
+    class InplaceFunction;
+
+    /**
+     * 只能移动的可调用对象包装，用于替换IO线程热路径上的std::function
+     *
+     * libstdc++的std::function只有16字节的内部存储，捕获了TcpConnectionPtr和string的lambda或者bind表达式
+     * 每次构造都要调用一次malloc。InplaceFunction在对象内部预留Capacity字节
+     * 大小不超过Capacity，且移动构造不抛异常的目标直接放在内部存储中，不分配内存；否则退化为在堆上分配
+     *
+     * 与std::function的区别
+     *  1. 不可拷贝，因此可以保存只能移动的目标(例如捕获了unique_ptr的lambda)
+     *  2. 调用空的InplaceFunction是未定义行为(有断言)，不抛出std::bad_function_call
+     */
+    template<typename R, typename... Args, size_t Capacity>
+    class InplaceFunction<R(Args...), Capacity>
+    {
+        private:
+            // 每种目标类型一份的操作表，代替虚函数
+            struct Ops
+            {
+                R (*invoke)(void* storage, Args&&... args);
+                void (*move)(void* dst, void* src);     // 移动构造到dst并析构src
+                void (*destroy)(void* storage);
+            };
+
+            template<typename F>
+            struct InlineOps
+            {
+                static R invoke(void* storage, Args&&... args)
+                {
+                    return (*static_cast<F*>(storage))(std::forward<Args>(args)...);
+                }
+
+                static void move(void* dst, void* src)
+                {
+                    F* f = static_cast<F*>(src);
+                    ::new (dst) F(std::move(*f));
+                    f->~F();
+                }
+
+                static void destroy(void* storage)
+                {
+                    static_cast<F*>(storage)->~F();
+                }
+
+                static const Ops ops;
+            };
+
+            // 内部存储只保存指向堆上目标的指针
+            template<typename F>
+            struct HeapOps
+            {
+                static F*& target(void* storage)
+                {
+                    return *static_cast<F**>(storage);
+                }
+
+                static R invoke(void* storage, Args&&... args)
+                {
+                    return (*target(storage))(std::forward<Args>(args)...);
+                }
+
+                static void move(void* dst, void* src)
+                {
+                    ::new (dst) F*(target(src));
+                }
+
+                static void destroy(void* storage)
+                {
+                    delete target(storage);
+                }
+
+                static const Ops ops;
+            };
+
+            template<typename F>
+            struct IsInlineable
+                : std::integral_constant<bool, sizeof(F) <= Capacity && alignof(F) <= alignof(std::max_align_t)
+                    && std::is_nothrow_move_constructible<F>::value>
+            {
+            };
+
+            alignas(std::max_align_t) mutable unsigned char storage_[Capacity];
+
+            const Ops* ops_;    // 为NULL时表示空
+
+        public:
+            static const size_t kCapacity = Capacity;
+
+            InplaceFunction(): ops_(NULL)
+            {
+            }
+
+            InplaceFunction(std::nullptr_t): ops_(NULL)
+            {
+            }
+
+            template<typename F, typename D = typename std::decay<F>::type,
+                typename = typename std::enable_if<!std::is_same<D, InplaceFunction>::value
+                    && std::is_invocable_r<R, D&, Args...>::value>::type>
+            InplaceFunction(F&& f): ops_(NULL)
+            {
+                if (isEmptyTarget(f)) {
+                    return;
+                }
+                construct<D>(std::forward<F>(f), IsInlineable<D>());
+            }
+
+            InplaceFunction(InplaceFunction&& rhs) noexcept: ops_(rhs.ops_)
+            {
+                if (ops_) {
+                    ops_->move(storage_, rhs.storage_);
+                    rhs.ops_ = NULL;
+                }
+            }
+
+            InplaceFunction(const InplaceFunction&) = delete;
+
+            InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+            InplaceFunction& operator=(InplaceFunction&& rhs) noexcept
+            {
+                if (this != &rhs) {
+                    reset();
+                    if (rhs.ops_) {
+                        rhs.ops_->move(storage_, rhs.storage_);
+                        ops_ = rhs.ops_;
+                        rhs.ops_ = NULL;
+                    }
+                }
+                return *this;
+            }
+
+            InplaceFunction& operator=(std::nullptr_t)
+            {
+                reset();
+                return *this;
+            }
+
+            template<typename F, typename D = typename std::decay<F>::type,
+                typename = typename std::enable_if<!std::is_same<D, InplaceFunction>::value>::type>
+            InplaceFunction& operator=(F&& f)
+            {
+                return *this = InplaceFunction(std::forward<F>(f));
+            }
+
+            ~InplaceFunction()
+            {
+                reset();
+            }
+
+            void swap(InplaceFunction& rhs) noexcept
+            {
+                InplaceFunction tmp(std::move(rhs));
+                rhs = std::move(*this);
+                *this = std::move(tmp);
+            }
+
+            explicit operator bool() const
+            {
+                return ops_ != NULL;
+            }
+
+            // 和std::function一样，const的调用会调用目标的非const operator()
+            R operator() (Args... args) const
+            {
+                assert(ops_ != NULL);
+                return ops_->invoke(storage_, std::forward<Args>(args)...);
+            }
+
+        private:
+            void reset()
+            {
+                if (ops_) {
+                    ops_->destroy(storage_);
+                    ops_ = NULL;
+                }
+            }
+
+            template<typename D, typename F>
+            void construct(F&& f, std::true_type)
+            {
+                ::new (static_cast<void*>(storage_)) D(std::forward<F>(f));
+                ops_ = &InlineOps<D>::ops;
+            }
+
+            template<typename D, typename F>
+            void construct(F&& f, std::false_type)
+            {
+                ::new (static_cast<void*>(storage_)) D*(new D(std::forward<F>(f)));
+                ops_ = &HeapOps<D>::ops;
+            }
+
+            // 空的函数指针和std::function构造出空的InplaceFunction，与std::function的行为一致
+            template<typename F>
+            static bool isEmptyTarget(const F&)
+            {
+                return false;
+            }
+
+            template<typename Ret, typename... A>
+            static bool isEmptyTarget(Ret (* const& f)(A...))
+            {
+                return f == NULL;
+            }
+
+            template<typename Sig>
+            static bool isEmptyTarget(const std::function<Sig>& f)
+            {
+                return !f;
+            }
+    };
+
+    template<typename R, typename... Args, size_t Capacity>
+    template<typename F>
+    const typename InplaceFunction<R(Args...), Capacity>::Ops InplaceFunction<R(Args...), Capacity>::InlineOps<F>::ops = {
+        &InlineOps<F>::invoke, &InlineOps<F>::move, &InlineOps<F>::destroy
+    };
+
+    template<typename R, typename... Args, size_t Capacity>
+    template<typename F>
+    const typename InplaceFunction<R(Args...), Capacity>::Ops InplaceFunction<R(Args...), Capacity>::HeapOps<F>::ops = {
+        &HeapOps<F>::invoke, &HeapOps<F>::move, &HeapOps<F>::destroy
+    };
+
+    template<typename R, typename... Args, size_t Capacity>
+    const size_t InplaceFunction<R(Args...), Capacity>::kCapacity;
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <charconv>
+#include <cmath>
 #include <limits>
 #include <string.h>
 #include <string>
@@ -130,11 +132,13 @@ LogStream& LogStream::operator<<(const void* p)
     return *this;
 }
 
+// 与"%.12g"的输出相同，std::to_chars用Ryu printf直接生成数字，不经过snprintf的格式串解析和locale
 LogStream& LogStream::operator<<(double v)
 {
     if (buffer_.avail() >= kMaxNumericSize) {
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v);
-        buffer_.add(len);
+        char* buf = buffer_.current();
+        std::to_chars_result result = std::to_chars(buf, buf + kMaxNumericSize, v, std::chars_format::general, 12);
+        buffer_.add(result.ptr - buf);
     }
     return *this;
 }
@@ -148,6 +152,69 @@ LogStream& LogStream::operator<<(long double v)
     return *this;
 }
 
+namespace
+{
+    const int64_t kPow10[] = {
+        1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+    };
+};
+
+/**
+ * 绝对值乘以10^precision之后小于2^52时，乘积的舍入误差不超过0.25，整数部分和小数部分用一个int64_t输出
+ * 就近取整，恰好是一半时取偶数，与printf相同，乘法的舍入造成的"一半"用fma算出的误差决定方向
+ * 其它情况(更大的值、NaN、无穷)交给std::to_chars
+ */
+Fixed::Fixed(double val, int precision)
+{
+    assert(precision >= 0 && precision <= kMaxPrecision);
+    double pow10 = static_cast<double>(kPow10[precision]);
+    double scaled = std::fabs(val) * pow10;
+
+    if (scaled < 4503599627370496.0) {
+        double rounded = std::nearbyint(scaled);
+        double half = scaled - rounded;
+        if (half == 0.5 || half == -0.5) {
+            double lower = scaled - 0.5;
+            double error = std::fma(std::fabs(val), pow10, -scaled);
+            if (error > 0) {
+                rounded = lower + 1;
+            } else if (error < 0) {
+                rounded = lower;
+            }
+        }
+        int64_t n = static_cast<int64_t>(rounded);
+        char* p = buf_;
+        if (std::signbit(val)) {
+            *p++ = '-';
+        }
+        p += convert(p, n / kPow10[precision]);
+        if (precision > 0) {
+            *p++ = '.';
+            int64_t frac = n % kPow10[precision];
+            for (int i = precision; i > 0; --i) {
+                p[i - 1] = static_cast<char>('0' + frac % 10);
+                frac /= 10;
+            }
+            p += precision;
+        }
+        length_ = static_cast<int>(p - buf_);
+    } else {
+        std::to_chars_result result = std::to_chars(buf_, buf_ + sizeof buf_, val, std::chars_format::fixed, precision);
+        if (result.ec != std::errc()) {
+            // 超过缓冲区的大数改用科学计数法
+            result = std::to_chars(buf_, buf_ + sizeof buf_, val, std::chars_format::scientific, precision);
+        }
+        length_ = static_cast<int>(result.ptr - buf_);
+    }
+}
+
+Shortest::Shortest(double val)
+{
+    std::to_chars_result result = std::to_chars(buf_, buf_ + sizeof buf_, val);
+    assert(result.ec == std::errc());
+    length_ = static_cast<int>(result.ptr - buf_);
+}
+
 template<typename T>
 Fmt::Fmt(const char* fmt, T val) 
 {
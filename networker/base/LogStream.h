@@ -184,5 +184,65 @@ namespace networker
         return s;
     }
 
+    /**
+     * 保留precision位小数输出double，例如 LOG_INFO << "took " << Fixed(ms, 3) << "ms"
+     * 常见的数值用整数运算格式化，不调用snprintf
+     */
+    class Fixed
+    {
+        public:
+            static const int kMaxPrecision = 9;
+
+        private:
+            char buf_[64];
+            int length_;
+
+        public:
+            Fixed(double val, int precision);
+
+            const char* data() const
+            {
+                return buf_;
+            }
+
+            int length() const
+            {
+                return length_;
+            }
+    };
+
+    inline LogStream& operator <<(LogStream& s, const Fixed& fixed)
+    {
+        s.append(fixed.data(), fixed.length());
+        return s;
+    }
+
+    // 能精确还原的最短表示(std::to_chars，Ryu)，例如0.1输出"0.1"，1e+100输出"1e+100"
+    class Shortest
+    {
+        private:
+            char buf_[32];
+            int length_;
+
+        public:
+            explicit Shortest(double val);
+
+            const char* data() const
+            {
+                return buf_;
+            }
+
+            int length() const
+            {
+                return length_;
+            }
+    };
+
+    inline LogStream& operator <<(LogStream& s, const Shortest& shortest)
+    {
+        s.append(shortest.data(), shortest.length());
+        return s;
+    }
+
 };
 #endif
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <time.h>  
 #include <errno.h>
 #include <sys/time.h> 
+#include <atomic>
 #include "networker/base/Logging.h"
 #include "networker/base/CurrentThread.h"
 #include "networker/base/Timestamp.h"
@@ -13,6 +14,7 @@ namespace networker
     __thread char t_errnobuf[512];
     __thread char t_time[64];
     __thread time_t t_lastSecond;
+    __thread int t_lastTimeZone;
 
     const char* strerror_tl(int savedErrno)
     {
@@ -80,12 +82,142 @@ namespace networker
     Logger::OutputFunc g_output = defaultOutput;
     Logger::FlushFunc g_flush = defaultFlush;
     TimeZone g_logTimeZone;
+    bool g_logCoarseClock = false;
+
+    // setTimeZone时递增，让各个线程和共享的时间缓存失效
+    std::atomic<int> g_logTimeZoneGeneration(1);
+
+    /**
+     * 所有线程共享的"YYYYmmdd HH:MM:SS"缓存，每秒只需要一个线程计算一次
+     *
+     * 用seqlock保护: 写者把seq_变成奇数后写入，写完再加一变成偶数，读者前后两次读到相同的偶数才算成功
+     * 写者用CAS抢占，抢不到的线程自己格式化，读者和写者都不会等待
+     * 数据也用relaxed的原子变量保存，并发读写没有数据竞争
+     */
+    class LogTimeCache
+    {
+        private:
+            static const int kWords = 3;
+
+            std::atomic<uint32_t> seq_;
+            std::atomic<int64_t> second_;
+            std::atomic<int> generation_;
+            std::atomic<uint64_t> words_[kWords];
+
+        public:
+            LogTimeCache(): seq_(0), second_(-1), generation_(0)
+            {
+                for (int i = 0; i < kWords; ++i) {
+                    words_[i].store(0, std::memory_order_relaxed);
+                }
+            }
+
+            // 成功时把17个字节的前缀拷贝到out
+            bool read(int64_t second, int generation, char* out) const
+            {
+                uint32_t seq = seq_.load(std::memory_order_acquire);
+                if ((seq & 1) != 0 || second_.load(std::memory_order_relaxed) != second ||
+                    generation_.load(std::memory_order_relaxed) != generation) {
+                    return false;
+                }
+
+                uint64_t words[kWords];
+                for (int i = 0; i < kWords; ++i) {
+                    words[i] = words_[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (seq_.load(std::memory_order_relaxed) != seq) {
+                    return false;
+                }
+
+                memcpy(out, words, 17);
+                return true;
+            }
+
+            void write(int64_t second, int generation, const char* prefix)
+            {
+                uint32_t seq = seq_.load(std::memory_order_relaxed);
+                if ((seq & 1) != 0 || !seq_.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed)) {
+                    return;
+                }
+                std::atomic_thread_fence(std::memory_order_release);
+
+                uint64_t words[kWords] = { 0, 0, 0 };
+                memcpy(words, prefix, 17);
+                second_.store(second, std::memory_order_relaxed);
+                generation_.store(generation, std::memory_order_relaxed);
+                for (int i = 0; i < kWords; ++i) {
+                    words_[i].store(words[i], std::memory_order_relaxed);
+                }
+                seq_.store(seq + 2, std::memory_order_release);
+            }
+    };
+
+    LogTimeCache g_logTimeCache;
+
+    // ".uuuuuu"，常数除法被编译成乘法，没有snprintf和分支
+    inline void formatMicroseconds(char* buf, int microseconds)
+    {
+        buf[0] = '.';
+        for (int i = 6; i >= 1; --i) {
+            buf[i] = static_cast<char>('0' + microseconds % 10);
+            microseconds /= 10;
+        }
+    }
+
+    /**
+     * 写出"YYYYmmdd HH:MM:SS.uuuuuu"，UTC时加上'Z'，再加一个空格
+     * 秒数变化时先查所有线程共享的缓存，只有每秒第一个遇到的线程调用gmtime_r/TimeZone格式化
+     */
+    void formatLogTime(LogStream& stream, Timestamp time)
+    {
+        int64_t microSecondsSinceEpoch = time.microSecondsSinceEpoch();
+        time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / Timestamp::kMicroSecondsPerSecond);
+        int microseconds = static_cast<int> (microSecondsSinceEpoch % Timestamp::kMicroSecondsPerSecond);
+        int generation = g_logTimeZoneGeneration.load(std::memory_order_relaxed);
+
+        if (seconds != t_lastSecond || generation != t_lastTimeZone) {
+            t_lastSecond = seconds;
+            t_lastTimeZone = generation;
+
+            if (!g_logTimeCache.read(seconds, generation, t_time)) {
+                struct tm tm_time;
+                if (g_logTimeZone.valid()) {
+                    tm_time = g_logTimeZone.toLocalTime(seconds);
+                } else {
+                    ::gmtime_r(&seconds, &tm_time);
+                }
+
+                int len = snprintf(t_time, sizeof(t_time), "%4d%02d%02d %02d:%02d:%02d",
+                    tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                    tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
+            
+                assert(len == 17);
+                (void)len;
+                g_logTimeCache.write(seconds, generation, t_time);
+            }
+        }
+
+        // ".uuuuuu" 之后，UTC时加上'Z'，再加一个空格
+        char us[10];
+        formatMicroseconds(us, microseconds);
+        if (g_logTimeZone.valid()) {
+            us[7] = ' ';
+            us[8] = '\0';
+            stream << T(t_time, 17) << T(us, 8);
+        } else {
+            us[7] = 'Z';
+            us[8] = ' ';
+            us[9] = '\0';
+            stream << T(t_time, 17) << T(us, 9);
+        }
+    }
 };
 
 using namespace networker;
 
 Logger::RecordBlock::RecordBlock(LogLevel level, int savedErrno, const SourceFile& file, int line) 
-    : time_(Timestamp::now()), stream_(), 
+    : time_(g_logCoarseClock ? Timestamp::nowCoarse() : Timestamp::now()), stream_(), 
     level_(level), line_(line), basename_(file)
 {
     formatTime();
@@ -102,36 +234,14 @@ Logger::RecordBlock::RecordBlock(LogLevel level, int savedErrno, const SourceFil
 // 记录当前时间
 void Logger::RecordBlock::formatTime() 
 {
-    int64_t microSecondsSinceEpoch = time_.microSecondsSinceEpoch();
-    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / Timestamp::kMicroSecondsPerSecond);
-    int microseconds = static_cast<int> (microSecondsSinceEpoch % Timestamp::kMicroSecondsPerSecond);
-
-    if (seconds != t_lastSecond) {
-        t_lastSecond = seconds;
-        struct tm tm_time;
-        if (g_logTimeZone.valid()) {
-            tm_time = g_logTimeZone.toLocalTime(seconds);
-        } else {
-            ::gmtime_r(&seconds, &tm_time);
-        }
-
-        int len = snprintf(t_time, sizeof(t_time), "%4d%02d%02d %02d:%02d:%02d",
-            tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
-            tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec);
-        
-        assert(len == 17);
-        (void)len;
-    }
+    formatLogTime(stream_, time_);
+}
 
-    if (g_logTimeZone.valid()) {
-        Fmt us(".%06d ", microseconds);
-        assert(us.length() == 8);
-        stream_ << T(t_time, 17) << T(us.data(), 8);
-    } else {
-        Fmt us(".%06dZ ", microseconds);
-        assert(us.length() == 9);
-        stream_ << T(t_time, 17) << T(us.data(), 9);
-    }
+void Logger::formatHeader(LogStream& stream, Timestamp time, int tid, LogLevel level)
+{
+    formatLogTime(stream, time);
+    stream << Fmt("%5d", tid) << ' ';
+    stream << T(LogLevelName[level], 6);
 }
 
 void Logger::RecordBlock::finish() 
@@ -183,7 +293,18 @@ void Logger::setFlush(FlushFunc flush)
     g_flush = flush;
 }
 
+Logger::OutputFunc Logger::outputFunc()
+{
+    return g_output;
+}
+
 void Logger::setTimeZone(const TimeZone& tz)
 {
     g_logTimeZone = tz;
+    g_logTimeZoneGeneration.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::setCoarseClock(bool on)
+{
+    g_logCoarseClock = on;
 }
\ No newline at end of file
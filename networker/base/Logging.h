@@ -84,6 +84,18 @@ namespace networker
             static void setOutput(OutputFunc);
             static void setFlush(FlushFunc);
             static void setTimeZone(const TimeZone& tz);
+
+            /**
+             * 日志的时间戳使用Timestamp::nowCoarse()，精度降为时钟节拍(通常1~4ms)，换取更低的开销
+             * 在程序启动时设置
+             */
+            static void setCoarseClock(bool on);
+
+            // 当前的输出函数，供不经过Logger对象输出的日志使用(BinaryLogging)
+            static OutputFunc outputFunc();
+
+            // 按Logger的格式写出一行日志的前缀"时间 线程ID 级别 "，用于在其它线程中格式化的日志
+            static void formatHeader(LogStream& stream, Timestamp time, int tid, LogLevel level);
             
         private:
             class RecordBlock
@@ -106,6 +118,7 @@ namespace networker
     };
 
     extern Logger::LogLevel g_logLevel;
+    extern bool g_logCoarseClock;
 
     inline Logger::LogLevel Logger::logLevel()
     {
@@ -114,23 +127,45 @@ namespace networker
 
     const char *strerror_tl(int savedErrno);
 
+    /**
+     * 编译时的最低日志级别，0(TRACE)到5(FATAL)，例如 -DNETWORKER_MIN_LOG_LEVEL=2 只保留INFO及以上
+     * 低于它的LOG_*的条件是编译期常量false，整条语句被编译器删除，也就不会再读取g_logLevel
+     * LOG_FATAL和LOG_SYSFATAL总是保留
+     */
+    #ifndef NETWORKER_MIN_LOG_LEVEL
+    #define NETWORKER_MIN_LOG_LEVEL 0
+    #endif
+
+    /**
+     * if (!(cond)) {} else stream << ...
+     * 条件不成立时<<右边的参数不会被求值，宏后面的else也不会和宏里面的if配对
+     * 日志输出是冷路径，用__builtin_expect让编译器把它放到热路径之外
+     */
+    #define NETWORKER_LOG_IF(cond) if (!__builtin_expect(!!(cond), 0)) {} else
+
+    #define NETWORKER_LOG_ENABLED(level) \
+    ((level) >= NETWORKER_MIN_LOG_LEVEL && Logger::logLevel() <= (level))
+
     // 日志打印宏
-    #define LOG_TRACE if (Logger::logLevel() <= Logger::TRACE) \
+    #define LOG_TRACE NETWORKER_LOG_IF(NETWORKER_LOG_ENABLED(Logger::TRACE)) \
     Logger(__FILE__, __LINE__, Logger::TRACE, __func__).stream()
 
-    #define LOG_DEBUG if (Logger::logLevel() <= Logger::DEBUG) \
+    #define LOG_DEBUG NETWORKER_LOG_IF(NETWORKER_LOG_ENABLED(Logger::DEBUG)) \
     Logger(__FILE__, __LINE__, Logger::DEBUG, __func__).stream()
 
-    #define LOG_INFO if (Logger::logLevel() <= Logger::INFO) \
+    #define LOG_INFO NETWORKER_LOG_IF(NETWORKER_LOG_ENABLED(Logger::INFO)) \
     Logger(__FILE__, __LINE__).stream()
 
-    #define LOG_WARN Logger(__FILE__, __LINE__, Logger::WARN).stream()
+    #define LOG_WARN NETWORKER_LOG_IF(Logger::WARN >= NETWORKER_MIN_LOG_LEVEL) \
+    Logger(__FILE__, __LINE__, Logger::WARN).stream()
 
-    #define LOG_ERROR Logger(__FILE__, __LINE__, Logger::ERROR).stream()
+    #define LOG_ERROR NETWORKER_LOG_IF(Logger::ERROR >= NETWORKER_MIN_LOG_LEVEL) \
+    Logger(__FILE__, __LINE__, Logger::ERROR).stream()
 
     #define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL).stream()
 
-    #define LOG_SYSERR Logger(__FILE__, __LINE__, false).stream()
+    #define LOG_SYSERR NETWORKER_LOG_IF(Logger::ERROR >= NETWORKER_MIN_LOG_LEVEL) \
+    Logger(__FILE__, __LINE__, false).stream()
 
     #define LOG_SYSFATAL Logger(__FILE__, __LINE__, true).stream()
 };
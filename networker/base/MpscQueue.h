@@ -0,0 +1,179 @@
+#ifndef NETWORKER_BASE_MPSCQUEUE_H
+#define NETWORKER_BASE_MPSCQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+#include "networker/base/noncopyable.h"
+
+namespace networker
+{
+    /**
+     * 无锁的多生产者单消费者队列(Dmitry Vyukov 的非侵入式MPSC队列)
+     *
+     * push 可以在任意线程调用，只有一次原子交换，不会阻塞
+     * pop 只能在唯一的消费者线程调用
+     *
+     * 队列中始终有一个哑结点(stub)，tail_指向它，真正的元素从tail_->next_开始
+     * 生产者交换head_之后到链接prev->next_之前，元素对消费者暂时不可见，此时pop会返回false
+     *
+     * pop释放的结点放入空闲栈，push优先从空闲栈取结点，队列长度在到达过的最大值和kMaxFreeNodes以内时入队不再分配内存
+     * 空闲栈最多保留大约kMaxFreeNodes个结点，超出且没有生产者正在取结点时直接delete，其余的在队列析构时释放
+     * 否则一次突发的积压之后空闲结点会一直占着内存
+     */
+    template<typename T>
+    class MpscQueue: noncopyable
+    {
+        private:
+            struct Node
+            {
+                std::atomic<Node*> next_;
+                T value_;
+
+                Node(): next_(NULL)
+                {
+                }
+            };
+
+            // 空闲栈的栈顶: 低48位是结点地址，高16位是版本号，每次出栈加一，防止ABA
+            static const int kTagShift = 48;
+            static const uint64_t kPointerMask = (static_cast<uint64_t>(1) << kTagShift) - 1;
+
+            static_assert(sizeof(void*) == 8, "MpscQueue packs a 48-bit address and a tag into 64 bits");
+
+            static const size_t kMaxFreeNodes = 4096;
+
+            std::atomic<Node*> head_;   // 生产者端，最后加入的结点
+
+            Node* tail_;                // 消费者端，哑结点
+
+            // push时先加一，pop之后再减一，因此不会小于队列中可见元素的个数
+            std::atomic<size_t> size_;
+
+            // 空闲结点通过next_链接，只有消费者入栈，生产者出栈
+            std::atomic<uint64_t> freeList_;
+
+            // 空闲栈中结点的近似个数，入栈前先加一，出栈之后再减一，因此不会下溢
+            std::atomic<size_t> freeCount_;
+
+            // 正在allocNode中读空闲栈的生产者个数，不为0时消费者不delete结点
+            std::atomic<int> allocating_;
+
+        public:
+            MpscQueue(): head_(new Node), tail_(head_.load(std::memory_order_relaxed)), size_(0), freeList_(0), freeCount_(0), allocating_(0)
+            {
+            }
+
+            ~MpscQueue()
+            {
+                T value;
+                while (pop(&value)) {
+                }
+                delete tail_;
+
+                Node* node = reinterpret_cast<Node*>(freeList_.load() & kPointerMask);
+                while (node != NULL) {
+                    Node* next = node->next_.load(std::memory_order_relaxed);
+                    delete node;
+                    node = next;
+                }
+            }
+
+            void push(T value)
+            {
+                Node* node = allocNode();
+                node->next_.store(NULL, std::memory_order_relaxed);
+                node->value_ = std::move(value);
+                size_.fetch_add(1);
+                Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+                prev->next_.store(node, std::memory_order_release);
+            }
+
+            // 只能在消费者线程调用
+            bool pop(T* value)
+            {
+                Node* tail = tail_;
+                Node* next = tail->next_.load(std::memory_order_acquire);
+                if (next == NULL) {
+                    return false;
+                }
+
+                *value = std::move(next->value_);
+                // next 成为新的哑结点，尽早释放被移走元素的资源
+                next->value_ = T();
+                tail_ = next;
+                freeNode(tail);
+                size_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+
+            // 可以在任意线程调用，不加锁
+            size_t size() const
+            {
+                return size_.load();
+            }
+
+            bool empty() const
+            {
+                return size() == 0;
+            }
+
+        private:
+            /**
+             * 从空闲栈取一个结点，栈空时new一个
+             * 读到的node可能已经被其它生产者取走、入队又被消费者取出，
+             * allocating_不为0时消费者不会delete它，读node->next_是安全的，这时栈顶的版本号已经变了，CAS失败后重试
+             *
+             * allocating_的加一和freeList_的读都是seq_cst，消费者看到allocating_为0时，
+             * 之后进来的生产者一定读到比消费者拿到的结点出栈更新的栈顶
+             */
+            Node* allocNode()
+            {
+                if ((freeList_.load(std::memory_order_relaxed) & kPointerMask) == 0) {
+                    return new Node;
+                }
+
+                allocating_.fetch_add(1);
+                Node* node;
+                uint64_t top = freeList_.load();
+                for (;;) {
+                    node = reinterpret_cast<Node*>(top & kPointerMask);
+                    if (node == NULL) {
+                        break;
+                    }
+                    Node* next = node->next_.load(std::memory_order_relaxed);
+                    uint64_t newTop = reinterpret_cast<uintptr_t>(next) | (((top >> kTagShift) + 1) << kTagShift);
+                    if (freeList_.compare_exchange_weak(top, newTop)) {
+                        freeCount_.fetch_sub(1, std::memory_order_relaxed);
+                        break;
+                    }
+                }
+                allocating_.fetch_sub(1, std::memory_order_release);
+                return node != NULL ? node : new Node;
+            }
+
+            /**
+             * 只在消费者线程调用，node的元素已经移走
+             * 空闲结点够多时直接delete，但node可能之前在空闲栈中，还有生产者在allocNode中读它，见allocNode
+             */
+            void freeNode(Node* node)
+            {
+                if (freeCount_.load(std::memory_order_relaxed) >= kMaxFreeNodes && allocating_.load() == 0) {
+                    delete node;
+                    return;
+                }
+                freeCount_.fetch_add(1, std::memory_order_relaxed);
+
+                uint64_t top = freeList_.load(std::memory_order_relaxed);
+                uint64_t newTop;
+                do {
+                    node->next_.store(reinterpret_cast<Node*>(top & kPointerMask), std::memory_order_relaxed);
+                    newTop = reinterpret_cast<uintptr_t>(node) | (top & ~kPointerMask);
+                } while (!freeList_.compare_exchange_weak(top, newTop, std::memory_order_release, std::memory_order_relaxed));
+            }
+    };
+};
+
+#endif
@@ -52,7 +52,7 @@ namespace networker
 
             }
 
-            StringPiece(const string& str): ptr_(str.data()), length_(static_cast<int>(strlen(ptr_)))
+            StringPiece(const string& str): ptr_(str.data()), length_(static_cast<int>(str.size()))
             {
 
             }
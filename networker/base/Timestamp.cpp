@@ -1,6 +1,7 @@
 #include <sys/time.h>
 #include <stdio.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include "networker/base/Timestamp.h"
 
@@ -45,4 +46,16 @@ Timestamp Timestamp::now()
     gettimeofday(&tv, NULL);
     int64_t seconds = tv.tv_sec;
     return Timestamp(seconds * kMicroSecondsPerSecond + tv.tv_usec);
+}
+
+Timestamp Timestamp::nowCoarse()
+{
+#ifdef CLOCK_REALTIME_COARSE
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    int64_t seconds = ts.tv_sec;
+    return Timestamp(seconds * kMicroSecondsPerSecond + ts.tv_nsec / 1000);
+#else
+    return now();
+#endif
 }
\ No newline at end of file
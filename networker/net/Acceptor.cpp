@@ -2,7 +2,9 @@
 #include "networker/net/EventLoop.h"
 #include "networker/net/InetAddress.h"
 #include "networker/net/SocketsOps.h"
+#include "networker/base/Logging.h"
 
+#include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -10,9 +12,24 @@
 using namespace networker;
 using namespace networker::net;
 
+namespace
+{
+    int dupOrDie(int fd)
+    {
+        int newfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (newfd < 0) {
+            LOG_SYSFATAL << "Acceptor - dup listen fd " << fd;
+        }
+        return newfd;
+    }
+};
+
+const int Acceptor::kDefaultBatchSize;
+
 Acceptor::Acceptor(EventLoop *loop, const InetAddress& listenAddr, bool reuseport)
     :loop_(loop),  acceptSocket_(sockets::createNonblockingOrDie(listenAddr.family())), 
-    acceptChannel_(loop, acceptSocket_.fd()), listenning_(false), idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC))
+    acceptChannel_(loop, acceptSocket_.fd()), listenning_(false), idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    batchSize_(kDefaultBatchSize), completionIo_(false), wakeups_(0), accepted_(0), fullBatches_(0), maxBatch_(0), emfile_(0)
 {
     assert(idleFd_ >= 0);
     
@@ -26,6 +43,18 @@ Acceptor::Acceptor(EventLoop *loop, const InetAddress& listenAddr, bool reusepor
     );
 }
 
+Acceptor::Acceptor(EventLoop *loop, int listenFd)
+    :loop_(loop), acceptSocket_(dupOrDie(listenFd)),
+    acceptChannel_(loop, acceptSocket_.fd()), listenning_(false), idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)),
+    batchSize_(kDefaultBatchSize), completionIo_(false), wakeups_(0), accepted_(0), fullBatches_(0), maxBatch_(0), emfile_(0)
+{
+    assert(idleFd_ >= 0);
+
+    acceptChannel_.setReadCallback(
+        std::bind(&Acceptor::handleRead, this)
+    );
+}
+
 Acceptor::~Acceptor()
 {
     acceptChannel_.disableAll();
@@ -38,33 +67,112 @@ void Acceptor::listen()
     loop_->assertInLoopThread();
     listenning_ = true;
     acceptSocket_.listen();
+    if (completionIo_ && loop_->supportsCompletionIo()) {
+        acceptChannel_.setCompletionMode(Channel::kAcceptCompletion);
+    }
     acceptChannel_.enableReading();
 }
 
-// 接受客户端的连接，并回调用户callback
+/**
+ * 接受客户端的连接，并回调用户callback
+ * 
+ * 每次可读事件最多accept batchSize_次，连接风暴时不必为每个连接都走一次poll
+ * 有上限是为了不让一个繁忙的监听socket饿死同一个EventLoop中的其它连接
+ */
 void Acceptor::handleRead()
 {
     loop_->assertInLoopThread();
-    InetAddress peerAddr;
-
-    int connfd = acceptSocket_.accept(&peerAddr);
-    /*
-        这里没有考虑了文件描述符耗尽的情况，在拿到大于等于0的connfd之后，非阻塞poll(2)一下，看fd是否可读写
-        正常情况下poll(2)会返回writeable，表明connfd可用
-        如果poll(2)返回错误，表明connfd有问题，应该立刻关闭连接
-     */
-    if (connfd >= 0) {
-        if (newConnectionCallback_) {
-            newConnectionCallback_(connfd, peerAddr);
-        } else {
-            sockets::close(connfd);
+    wakeups_.store(wakeups_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (acceptChannel_.completionMode() == Channel::kAcceptCompletion) {
+        handleAcceptCompletion();
+        return;
+    }
+
+    int64_t n = 0;
+    bool drained = false;
+
+    for (int i = 0; i < batchSize_; ++i) {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);
+        /*
+            这里没有考虑了文件描述符耗尽的情况，在拿到大于等于0的connfd之后，非阻塞poll(2)一下，看fd是否可读写
+            正常情况下poll(2)会返回writeable，表明connfd可用
+            如果poll(2)返回错误，表明connfd有问题，应该立刻关闭连接
+         */
+        if (connfd >= 0) {
+            ++n;
+            if (newConnectionCallback_) {
+                newConnectionCallback_(connfd, peerAddr);
+            } else {
+                sockets::close(connfd);
+            }
+            continue;
         }
-    } else {
-        if (errno == EMFILE) {
-            ::close(idleFd_);
-            idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
-            ::close(idleFd_);
-            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+        int savedErrno = errno;
+        if (savedErrno == ECONNABORTED || savedErrno == EINTR || savedErrno == EPROTO) {
+            // 只影响这一个连接，继续取下一个
+            continue;
         }
+
+        if (savedErrno == EMFILE) {
+            dropOneConnection();
+        }
+        // EAGAIN: 监听队列已经取空
+        drained = true;
+        break;
+    }
+
+    accepted_.store(accepted_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    if (!drained) {
+        fullBatches_.store(fullBatches_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    if (n > maxBatch_.load(std::memory_order_relaxed)) {
+        maxBatch_.store(n, std::memory_order_relaxed);
     }
 }
+
+/**
+ * 完成模式: 连接已经由内核接受，只取走这一轮的结果
+ * 一轮的数量由内核决定，batchSize_不起作用，fullBatches_不再统计
+ */
+void Acceptor::handleAcceptCompletion()
+{
+    int64_t n = 0;
+    int savedErrno = 0;
+    int connfd;
+    while ((connfd = loop_->takeAccepted(&acceptChannel_, &savedErrno)) >= 0 || savedErrno != EWOULDBLOCK) {
+        if (connfd >= 0) {
+            ++n;
+            if (newConnectionCallback_) {
+                newConnectionCallback_(connfd, InetAddress(sockets::getPeerAddr(connfd)));
+            } else {
+                sockets::close(connfd);
+            }
+        } else if (savedErrno == EMFILE || savedErrno == ENFILE) {
+            // multishot accept因此终止，Poller在下一轮重新提交
+            dropOneConnection();
+        } else if (savedErrno != ECONNABORTED && savedErrno != EINTR && savedErrno != EPROTO) {
+            errno = savedErrno;
+            LOG_SYSERR << "Acceptor::handleAcceptCompletion";
+        }
+    }
+
+    accepted_.store(accepted_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    if (n > maxBatch_.load(std::memory_order_relaxed)) {
+        maxBatch_.store(n, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * 文件描述符耗尽，腾出预留的idleFd_接受一个连接并立即关闭，否则监听socket会一直可读(busy loop)
+ * 每次可读事件只丢弃一个连接，其余的等有fd释放之后再接受
+ */
+void Acceptor::dropOneConnection()
+{
+    ::close(idleFd_);
+    idleFd_ = ::accept(acceptSocket_.fd(), NULL, NULL);
+    ::close(idleFd_);
+    idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+    emfile_.store(emfile_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
@@ -1,6 +1,7 @@
 #ifndef NETWORKER_NET_ACCEPTOR_H
 #define NETWORKER_NET_ACCEPTOR_H
 
+#include <atomic>
 #include <functional>
 
 #include "networker/net/Channel.h"
@@ -28,10 +29,27 @@ namespace net
             NewConnectionCallback newConnectionCallback_;
             bool listenning_;
             int idleFd_;
+            int batchSize_;     // 每次可读事件最多accept的次数
+            bool completionIo_; // 由Poller提交multishot accept，见setCompletionIo
+
+            // 统计，只在IO线程中修改，可以在任意线程读取
+            std::atomic<int64_t> wakeups_;      // 可读事件的次数
+            std::atomic<int64_t> accepted_;     // 接受的连接数
+            std::atomic<int64_t> fullBatches_;  // 用满了batchSize_仍未取空监听队列的次数，说明监听队列积压
+            std::atomic<int64_t> maxBatch_;     // 单次可读事件接受的最多连接数
+            std::atomic<int64_t> emfile_;       // 因文件描述符耗尽而丢弃的连接数
         
         public:
+            static const int kDefaultBatchSize = 64;
+
             Acceptor(EventLoop *loop, const InetAddress& listenAddr, bool reuseport);
 
+            /**
+             * 与另一个Acceptor共享同一个监听socket(构造时dup(listenFd)，各自关闭自己的fd)
+             * 多个IO线程各自等待同一个监听队列，通常配合setExclusive(true)使用
+             */
+            Acceptor(EventLoop *loop, int listenFd);
+
             ~Acceptor();
 
             void setNewConnectionCallback(const NewConnectionCallback& cb)
@@ -44,10 +62,71 @@ namespace net
                 return listenning_;
             }
 
+            int fd() const
+            {
+                return acceptSocket_.fd();
+            }
+
+            // 必须在listen之前调用
+            void setBatchSize(int batchSize)
+            {
+                assert(batchSize > 0);
+                batchSize_ = batchSize;
+            }
+
+            // 见 Channel::setExclusive，必须在listen之前调用
+            void setExclusive(bool on)
+            {
+                acceptChannel_.setExclusive(on);
+            }
+
+            /**
+             * Poller支持时(io_uring)由内核持续accept，可读回调只取走已经接受的连接，不再调用accept(2)
+             * 不支持时仍然使用就绪通知，必须在listen之前调用
+             */
+            void setCompletionIo(bool on)
+            {
+                assert(!listenning_);
+                completionIo_ = on;
+            }
+
+            int64_t wakeups() const
+            {
+                return wakeups_.load(std::memory_order_relaxed);
+            }
+
+            int64_t accepted() const
+            {
+                return accepted_.load(std::memory_order_relaxed);
+            }
+
+            int64_t fullBatches() const
+            {
+                return fullBatches_.load(std::memory_order_relaxed);
+            }
+
+            int64_t maxBatch() const
+            {
+                return maxBatch_.load(std::memory_order_relaxed);
+            }
+
+            int64_t emfile() const
+            {
+                return emfile_.load(std::memory_order_relaxed);
+            }
+
             void listen();
+
+            // 见 Socket::attachReusePortCpuFilter
+            bool attachReusePortCpuFilter(int numSockets)
+            {
+                return acceptSocket_.attachReusePortCpuFilter(numSockets);
+            }
         
         private:
             void handleRead();
+            void handleAcceptCompletion();
+            void dropOneConnection();
 
     };
 };
@@ -1,48 +1,103 @@
 #include "networker/net/Buffer.h"
+#include "networker/net/BufferPool.h"
 #include "networker/net/SocketsOps.h"
 
 #include <errno.h>
-#include <sys/uio.h>
+#include <sys/ioctl.h>
 
 using namespace networker;
 using namespace networker::net;
 
-const char Buffer::kCRLF[] = "\r\n";
+char Buffer::emptyStorage_[Buffer::kCheapPrepend];
 
 const size_t Buffer::kCheapPrepend;
 const size_t Buffer::kInitialSize;
+const size_t Buffer::kMinReadSize;
+const size_t Buffer::kMaxReadSize;
 
 /**
- * 1. 使用了 scatter / gather IO，并且一部分缓冲区取自stack，这样输入缓冲区足够大，也节省了一次ioctl(socketFd, FIONREAD, &length)系统调用
- * 2. Buffer::readFd()只调用一次read(2)，而没有反复调用read(2)直到返回EAGAIN
+ * 1. 先用ioctl(FIONREAD)查询内核中已有的数据量，和这个Buffer最近几次读到的数据量一起决定预留的空间，
+ *    直接读进BufferPool的存储块，不经过栈上的extrabuf，读完之后也不需要再扩容拷贝一次
+ * 2. Buffer::readFd()不会反复调用read(2)直到返回EAGAIN(边沿触发由TcpConnection循环调用)
  */
 ssize_t Buffer::readFd(int fd, int *saveErrno)
 {
-    // 保存了一个ioctl()/FIONREAD 调用来指示要读取多少
-    char extrabuf[65536];
-    struct iovec vec[2];
-    const size_t writable = writableBytes();
-
-    vec[0].iov_base = begin() + writerIndex_;
-    vec[0].iov_len = writable;
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof(extrabuf);
-
     /**
-     * 当缓冲区中有足够的空间时，不要读入extrabuf
-     * 当使用extrabuf时，我们最多读取128k-1字节
+     * 预留 max(readSize_ - kCheapPrepend, 已到达的数据量)，已到达的数据量不超过kMaxReadSize
+     * 缓冲区为空时，按readSize_预留的空间加上kCheapPrepend刚好是一个readSize_大小的存储块
+     * 还有未读的数据时，现有的存储块放得下就把数据挪到前面原地预留，
+     * 放不下时grow按 kCheapPrepend + readableBytes() + 预留空间 分配，存储块会大于readSize_
      */
-    const int iovcnt = (writable < sizeof(extrabuf)) ? 2 : 1;
-    const ssize_t n = sockets::readv(fd, vec, iovcnt);
+    size_t reserve = readSize_ - kCheapPrepend;
+    int available = 0;
+    if (::ioctl(fd, FIONREAD, &available) == 0 && implicit_cast<size_t>(available) > reserve) {
+        reserve = std::min(implicit_cast<size_t>(available), kMaxReadSize);
+    }
+    ensureWritableBytes(reserve);
+
+    ssize_t n = sockets::read(fd, beginWrite(), writableBytes());
 
     if (n < 0) {
         *saveErrno = errno;
-    } else if (implicit_cast<size_t>(n) <= writable) {
-        writerIndex_ += n;
     } else {
-        writerIndex_ = buffer_.size();
-        append(extrabuf, n - writable);
+        writerIndex_ += n;
+        adjustReadSize(n);
+    }
+
+    // 什么也没读到(EAGAIN或者对端关闭)，把刚才拿的存储块还回去
+    if (readableBytes() == 0) {
+        retrieveAll();
     }
 
     return n;
+}
+
+/**
+ * 读满了就加倍，连续两次不到一半才减半，避免偶尔的小消息让大流量连接的预留空间抖动
+ */
+void Buffer::adjustReadSize(size_t n)
+{
+    if (n >= readSize_) {
+        readSize_ = std::min(readSize_ * 2, kMaxReadSize);
+        shrinkReadSize_ = false;
+    } else if (n < readSize_ / 2) {
+        if (shrinkReadSize_) {
+            readSize_ = std::max(readSize_ / 2, kMinReadSize);
+            shrinkReadSize_ = false;
+        } else {
+            shrinkReadSize_ = true;
+        }
+    } else {
+        shrinkReadSize_ = false;
+    }
+}
+
+void Buffer::grow(size_t len)
+{
+    size_t readable = readableBytes();
+    size_t capacity = 0;
+    size_t size = kCheapPrepend + readable + len;
+    // 超过BufferPool最大块的存储按两倍增长，避免反复追加时反复拷贝(池中的块本身就是2的幂)
+    if (size > BufferPool::kMaxChunkSize) {
+        size = std::max(size, 2 * capacity_);
+    }
+    char* storage = BufferPool::allocate(size, &capacity);
+
+    ::memcpy(storage + kCheapPrepend, peek(), readable);
+    if (hasStorage()) {
+        releaseStorage();
+    }
+
+    buffer_ = storage;
+    capacity_ = capacity;
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend + readable;
+}
+
+void Buffer::releaseStorage()
+{
+    assert(hasStorage());
+    BufferPool::deallocate(buffer_, capacity_);
+    buffer_ = emptyStorage_;
+    capacity_ = kCheapPrepend;
 }
\ No newline at end of file
@@ -3,10 +3,10 @@
 
 #include "networker/base/StringPiece.h"
 #include "networker/base/Types.h"
+#include "networker/net/DelimiterScan.h"
 #include "networker/net/Endian.h"
 
 #include <algorithm>
-#include <vector>
 #include <assert.h>
 #include <string.h>
 #include <iostream>
@@ -26,32 +26,77 @@ namespace net
     /// |                   |                  |                  |
     /// 0      <=      readerIndex   <=   writerIndex    <=     size
     /// @endcode
+    ///
+    /// 存储块来自当前线程的BufferPool，按需分配，数据读完(retrieveAll)时立即归还
+    /// 没有数据的Buffer不占用存储，所以大量空闲连接的输入/输出缓冲区不占内存
 
     class Buffer
     {
         private:
-            std::vector<char> buffer_;
+            char* buffer_;      // 没有存储块时指向emptyStorage_
+            size_t capacity_;
             size_t readerIndex_;
             size_t writerIndex_;
-            static const char kCRLF[];
+            size_t readSize_;           // readFd预测的下一次读取的数据量
+            bool shrinkReadSize_;       // 上一次读到的不到readSize_的一半
+            static char emptyStorage_[];
 
         public:
             static const size_t kCheapPrepend = 8;
             static const size_t kInitialSize = 1024;
 
-            explicit Buffer(size_t initialSize = kInitialSize): buffer_(kCheapPrepend + initialSize), 
-                readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend)
+            // readFd预留空间的范围，都是BufferPool存储块的大小
+            static const size_t kMinReadSize = 1024;
+            static const size_t kMaxReadSize = 128 * 1024;
+
+            // initialSize大于0时立即分配存储，否则第一次写入时才分配
+            explicit Buffer(size_t initialSize = 0): buffer_(emptyStorage_), capacity_(kCheapPrepend),
+                readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend), readSize_(kMinReadSize), shrinkReadSize_(false)
             {
+                if (initialSize > 0) {
+                    grow(initialSize);
+                }
                 assert(readableBytes() == 0);
-                assert(writableBytes() == initialSize);
+                assert(writableBytes() >= initialSize);
                 assert(prependableBytes() == kCheapPrepend);
             }
 
+            Buffer(const Buffer& rhs): buffer_(emptyStorage_), capacity_(kCheapPrepend),
+                readerIndex_(kCheapPrepend), writerIndex_(kCheapPrepend), readSize_(kMinReadSize), shrinkReadSize_(false)
+            {
+                append(rhs.peek(), rhs.readableBytes());
+            }
+
+            Buffer(Buffer&& rhs) noexcept: buffer_(rhs.buffer_), capacity_(rhs.capacity_),
+                readerIndex_(rhs.readerIndex_), writerIndex_(rhs.writerIndex_), readSize_(rhs.readSize_), shrinkReadSize_(rhs.shrinkReadSize_)
+            {
+                rhs.buffer_ = emptyStorage_;
+                rhs.capacity_ = kCheapPrepend;
+                rhs.readerIndex_ = kCheapPrepend;
+                rhs.writerIndex_ = kCheapPrepend;
+            }
+
+            Buffer& operator=(Buffer rhs)
+            {
+                swap(rhs);
+                return *this;
+            }
+
+            ~Buffer()
+            {
+                if (hasStorage()) {
+                    releaseStorage();
+                }
+            }
+
             void swap(Buffer& rhs)
             {
-                buffer_.swap(rhs.buffer_);
+                std::swap(buffer_, rhs.buffer_);
+                std::swap(capacity_, rhs.capacity_);
                 std::swap(readerIndex_, rhs.readerIndex_);
                 std::swap(writerIndex_, rhs.writerIndex_);
+                std::swap(readSize_, rhs.readSize_);
+                std::swap(shrinkReadSize_, rhs.shrinkReadSize_);
             }
 
             size_t readableBytes() const
@@ -61,7 +106,7 @@ namespace net
 
             size_t writableBytes() const
             {
-                return buffer_.size() - writerIndex_;
+                return capacity_ - writerIndex_;
             }
 
             size_t prependableBytes() const
@@ -76,17 +121,31 @@ namespace net
 
             const char* findCRLF() const
             {
-                const char* crlf = std::search(peek(), beginWrite(), kCRLF, kCRLF + 2);
-                return crlf == beginWrite() ? NULL : crlf;
+                return scan::findCRLF(peek(), beginWrite());
             }
 
             const char* findCRLF(const char* start) const
             {
                 assert(peek() <= start);
                 assert(start <= beginWrite());
-                // FIXME: replace with memmem()?
-                const char* crlf = std::search(start, beginWrite(), kCRLF, kCRLF+2);
-                return crlf == beginWrite() ? NULL : crlf;
+                return scan::findCRLF(start, beginWrite());
+            }
+
+            /**
+             * 可以接着上次继续的查找，*scanned是相对于peek()的偏移量，表示之前的字节已经检查过
+             * 找到时*scanned是CRLF的位置，没有找到时推进到已检查过的位置(最后一个字节可能是半个CRLF，下次再看)
+             * 不完整的行随着数据到达反复查找时不会重复扫描，retrieve之后偏移量失效，调用者要相应地减小或者清零
+             */
+            const char* findCRLF(size_t* scanned) const
+            {
+                assert(*scanned <= readableBytes());
+                const char* crlf = scan::findCRLF(peek() + *scanned, beginWrite());
+                if (crlf != NULL) {
+                    *scanned = crlf - peek();
+                } else if (readableBytes() > 0) {
+                    *scanned = std::max(*scanned, readableBytes() - 1);
+                }
+                return crlf;
             }
 
             const char* findEOL() const
@@ -103,6 +162,15 @@ namespace net
                 return static_cast<const char*>(eol);
             }
 
+            // 与findCRLF(size_t*)相同，单个字节直接用memchr(glibc中已经是向量化的实现)
+            const char* findEOL(size_t* scanned) const
+            {
+                assert(*scanned <= readableBytes());
+                const void* eol = memchr(peek() + *scanned, '\n', readableBytes() - *scanned);
+                *scanned = eol == NULL ? readableBytes() : static_cast<const char*>(eol) - peek();
+                return static_cast<const char*>(eol);
+            }
+
             /**
              * retrieve返回void，防止字符串str（retrieve（readableBytes（）），readableBytes（））
              */
@@ -143,10 +211,14 @@ namespace net
                 retrieve(sizeof(int8_t));
             }
 
+            // 数据读完了，把存储块还给BufferPool
             void retrieveAll()
             {
                 readerIndex_ = kCheapPrepend;
                 writerIndex_ = kCheapPrepend;
+                if (hasStorage()) {
+                    releaseStorage();
+                }
             }
 
             string retrieveAllAsString()
@@ -326,6 +398,9 @@ namespace net
             void prepend(const void* /*restrict*/ data, size_t len)
             {
                 assert(len <= prependableBytes());
+                if (!hasStorage()) {
+                    grow(0);
+                }
                 readerIndex_ -= len;
                 const char *d = static_cast<const char*>(data);
                 std::copy(d, d + len, begin() + readerIndex_);
@@ -339,30 +414,48 @@ namespace net
                 swap(other);
             }
 
-            // 返回当前向量分配的存储空间大小
+            // 返回当前存储块的大小，没有存储块时为0
             size_t internalCapacity() const
             {
-                return buffer_.capacity();
+                return hasStorage() ? capacity_ : 0;
             }
 
             ssize_t readFd(int fd, int *savedErrno);
 
+            // readFd下一次预留的空间
+            size_t readSize() const
+            {
+                return readSize_;
+            }
+
         private:
             char *begin()
             {
-                return &*buffer_.begin();
+                return buffer_;
             }
 
             const char* begin() const
             {
-                return &*buffer_.begin();
+                return buffer_;
             }
 
+            bool hasStorage() const
+            {
+                return buffer_ != emptyStorage_;
+            }
+
+            // 换一个至少能再写入len字节的存储块，可读数据移到新块的kCheapPrepend处
+            void grow(size_t len);
+
+            void releaseStorage();
+
+            void adjustReadSize(size_t n);
+
             void makeSpace(size_t len)
             {
                 if (writableBytes() + prependableBytes() < len + kCheapPrepend) {
-                    // 重新设置存储内存
-                    buffer_.resize(writerIndex_ + len);
+                    // 重新分配存储块
+                    grow(len);
                 } else {
                     // 将可读数据移到前面，在缓冲区内留出空间
                     assert(kCheapPrepend < readerIndex_);
@@ -0,0 +1,122 @@
+#include "networker/net/BufferPool.h"
+#include "networker/base/Logging.h"
+
+#include <assert.h>
+#include <stdlib.h>
+
+using namespace networker;
+using namespace networker::net;
+
+namespace
+{
+    __thread BufferPool* t_bufferPool = NULL;
+
+    // 大小为size的存储块所在的级别，超过kMaxChunkSize时返回-1
+    int sizeClassOf(size_t size)
+    {
+        if (size <= BufferPool::kMinChunkSize) {
+            return 0;
+        }
+        if (size > BufferPool::kMaxChunkSize) {
+            return -1;
+        }
+        return 64 - __builtin_clzll(static_cast<unsigned long long>(size - 1)) - 10;
+    }
+
+    size_t chunkSizeOf(int sizeClass)
+    {
+        return BufferPool::kMinChunkSize << sizeClass;
+    }
+
+    char* mallocOrDie(size_t size)
+    {
+        char* chunk = static_cast<char*>(::malloc(size));
+        if (chunk == NULL) {
+            LOG_SYSFATAL << "BufferPool malloc " << size;
+        }
+        return chunk;
+    }
+};
+
+static_assert((BufferPool::kMinChunkSize << (BufferPool::kNumClasses - 1)) == BufferPool::kMaxChunkSize, "size classes");
+static_assert(BufferPool::kMinChunkSize == 1024, "sizeClassOf assumes 1KB minimum chunk");
+
+const size_t BufferPool::kMinChunkSize;
+const size_t BufferPool::kMaxChunkSize;
+const int BufferPool::kNumClasses;
+const size_t BufferPool::kMaxCachedBytesPerClass;
+
+BufferPool::BufferPool(): cachedBytes_(0)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    for (int i = 0; i < kNumClasses; ++i) {
+        for (char* chunk: freeLists_[i]) {
+            ::free(chunk);
+        }
+    }
+}
+
+void BufferPool::setThreadPool(BufferPool* pool)
+{
+    t_bufferPool = pool;
+}
+
+BufferPool* BufferPool::threadPool()
+{
+    return t_bufferPool;
+}
+
+char* BufferPool::allocate(size_t size, size_t* capacity)
+{
+    int sizeClass = sizeClassOf(size);
+    if (sizeClass < 0) {
+        *capacity = size;
+        return mallocOrDie(size);
+    }
+
+    *capacity = chunkSizeOf(sizeClass);
+    BufferPool* pool = t_bufferPool;
+    return pool ? pool->get(sizeClass) : mallocOrDie(*capacity);
+}
+
+void BufferPool::deallocate(char* chunk, size_t capacity)
+{
+    int sizeClass = sizeClassOf(capacity);
+    BufferPool* pool = t_bufferPool;
+    if (pool && sizeClass >= 0) {
+        assert(chunkSizeOf(sizeClass) == capacity);
+        pool->put(sizeClass, chunk);
+    } else {
+        ::free(chunk);
+    }
+}
+
+char* BufferPool::get(int sizeClass)
+{
+    std::vector<char*>& freeList = freeLists_[sizeClass];
+    if (freeList.empty()) {
+        return mallocOrDie(chunkSizeOf(sizeClass));
+    }
+
+    // 后进先出，拿到最近释放的块
+    char* chunk = freeList.back();
+    freeList.pop_back();
+    cachedBytes_ -= chunkSizeOf(sizeClass);
+    return chunk;
+}
+
+void BufferPool::put(int sizeClass, char* chunk)
+{
+    size_t chunkSize = chunkSizeOf(sizeClass);
+    std::vector<char*>& freeList = freeLists_[sizeClass];
+    if ((freeList.size() + 1) * chunkSize > kMaxCachedBytesPerClass) {
+        ::free(chunk);
+        return;
+    }
+
+    freeList.push_back(chunk);
+    cachedBytes_ += chunkSize;
+}
@@ -0,0 +1,69 @@
+#ifndef NETWORKER_NET_BUFFERPOOL_H
+#define NETWORKER_NET_BUFFERPOOL_H
+
+#include "networker/base/noncopyable.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * Buffer存储的分级空闲链表，每个EventLoop一个，只在所属的IO线程中使用
+     *
+     * 存储块按2的幂分级(1KB ~ 256KB)，Buffer数据读完时把存储块还给当前线程的池，
+     * 空闲的连接不占用存储，活跃的连接再次分配时拿到的是刚刚用过(还在cache中)的块
+     * 更大的块直接malloc/free，不缓存
+     *
+     * 存储块都是单独malloc出来的，在任何线程都可以释放: 当前线程有池时放入该线程的池，否则直接free
+     * 所以Buffer可以在线程之间传递(比如TcpConnection::send(Buffer*)交换出来的数据)
+     */
+    class BufferPool: noncopyable
+    {
+        public:
+            static const size_t kMinChunkSize = 1024;
+            static const size_t kMaxChunkSize = 256 * 1024;
+            static const int kNumClasses = 9;
+
+            // 每一级最多缓存的字节数，超出的块直接free
+            static const size_t kMaxCachedBytesPerClass = 1024 * 1024;
+
+        private:
+            std::vector<char*> freeLists_[kNumClasses];
+
+            size_t cachedBytes_;
+
+        public:
+            BufferPool();
+
+            ~BufferPool();
+
+            // 设置当前线程使用的池，由EventLoop在构造和析构时调用
+            static void setThreadPool(BufferPool* pool);
+
+            // 当前线程的池，没有时为NULL
+            static BufferPool* threadPool();
+
+            // 分配至少size字节的存储块，实际大小由*capacity返回
+            static char* allocate(size_t size, size_t* capacity);
+
+            // 释放allocate返回的存储块，capacity必须是allocate返回的大小
+            static void deallocate(char* chunk, size_t capacity);
+
+            // 空闲链表中缓存的字节数
+            size_t cachedBytes() const
+            {
+                return cachedBytes_;
+            }
+
+        private:
+            char* get(int sizeClass);
+
+            void put(int sizeClass, char* chunk);
+    };
+};
+};
+
+#endif
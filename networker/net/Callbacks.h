@@ -2,6 +2,7 @@
 #define NETWORKER_NET_CALLBACKS_H
 
 #include "networker/base/Timestamp.h"
+#include "networker/base/InplaceFunction.h"
 
 #include <functional>
 #include <memory>
@@ -46,7 +47,13 @@ namespace net
 
     typedef std::shared_ptr<TcpConnection> TcpConnectionPtr;
 
-    typedef std::function<void()> TimerCallback;
+    // 只在IO线程内部移动，不需要拷贝，使用不分配内存的InplaceFunction
+    typedef InplaceFunction<void()> TimerCallback;
+
+    /**
+     * 下面的连接回调由TcpServer/TcpClient保存一份，再拷贝给每一个新建的TcpConnection，因此必须可拷贝
+     * 它们只在建立连接时拷贝一次，不在每次收发的热路径上，保留std::function
+     */
 
     typedef std::function<void (const TcpConnectionPtr&)> ConnectionCallback;
 
@@ -0,0 +1,313 @@
+#include "networker/net/ChainBuffer.h"
+#include "networker/net/BufferPool.h"
+#include "networker/net/SocketsOps.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+
+using namespace networker;
+using namespace networker::net;
+
+const size_t ChainBuffer::kCheapPrepend;
+const size_t ChainBuffer::kBlockSize;
+const size_t ChainBuffer::kMinTailRead;
+const int ChainBuffer::kMaxReadBlocks;
+const int ChainBuffer::kMaxIovecs;
+
+ChainBuffer::ChainBuffer(const ChainBuffer& rhs): readableBytes_(0)
+{
+    for (const Block& block: rhs.blocks_) {
+        append(block.data_ + block.readerIndex_, block.readableBytes());
+    }
+}
+
+ChainBuffer::Block ChainBuffer::newBlock(size_t minSize, size_t readerIndex)
+{
+    Block block;
+    block.data_ = BufferPool::allocate(std::max(minSize, kBlockSize), &block.capacity_);
+    block.readerIndex_ = readerIndex;
+    block.writerIndex_ = readerIndex;
+    return block;
+}
+
+void ChainBuffer::releaseBlock(Block& block)
+{
+    BufferPool::deallocate(block.data_, block.capacity_);
+    block.data_ = NULL;
+}
+
+/**
+ * 第一块从readerIndex_到末尾的空间容得下len字节时，直接把后面块中的数据拷贝到它的末尾
+ * 容不下时先把第一块的数据挪到kCheapPrepend处，还不够才换成一个足够大的新块
+ */
+const char* ChainBuffer::pullup(size_t len)
+{
+    assert(len <= readableBytes_);
+    if (len <= peekableBytes()) {
+        return peek();
+    }
+
+    // 先从链中取下第一块，deque在链头插入删除时引用会失效
+    Block head = blocks_.front();
+    blocks_.pop_front();
+
+    if (head.capacity_ - head.readerIndex_ < len) {
+        size_t readable = head.readableBytes();
+        if (head.capacity_ >= kCheapPrepend + len) {
+            ::memmove(head.data_ + kCheapPrepend, head.data_ + head.readerIndex_, readable);
+        } else {
+            Block block = newBlock(kCheapPrepend + len, kCheapPrepend);
+            ::memcpy(block.data_ + kCheapPrepend, head.data_ + head.readerIndex_, readable);
+            releaseBlock(head);
+            head = block;
+        }
+        head.readerIndex_ = kCheapPrepend;
+        head.writerIndex_ = kCheapPrepend + readable;
+    }
+
+    // 只拷贝不在第一块中的数据，拷完的块立即归还
+    size_t need = len - head.readableBytes();
+    while (need > 0) {
+        assert(!blocks_.empty());
+        Block& next = blocks_.front();
+        size_t n = std::min(need, next.readableBytes());
+        ::memcpy(head.data_ + head.writerIndex_, next.data_ + next.readerIndex_, n);
+        head.writerIndex_ += n;
+        next.readerIndex_ += n;
+        need -= n;
+
+        if (next.readableBytes() == 0) {
+            releaseBlock(next);
+            blocks_.pop_front();
+        }
+    }
+
+    blocks_.push_front(head);
+    return peek();
+}
+
+void ChainBuffer::retrieve(size_t len)
+{
+    assert(len <= readableBytes_);
+    readableBytes_ -= len;
+
+    while (len > 0) {
+        assert(!blocks_.empty());
+        Block& block = blocks_.front();
+        size_t readable = block.readableBytes();
+
+        if (len < readable) {
+            block.readerIndex_ += len;
+            break;
+        }
+
+        // 读完的块立即归还
+        len -= readable;
+        releaseBlock(block);
+        blocks_.pop_front();
+    }
+}
+
+void ChainBuffer::retrieveAll()
+{
+    for (Block& block: blocks_) {
+        releaseBlock(block);
+    }
+    blocks_.clear();
+    readableBytes_ = 0;
+}
+
+string ChainBuffer::retrieveAsString(size_t len)
+{
+    assert(len <= readableBytes_);
+    string result(len, '\0');
+    copyOut(0, &*result.begin(), len);
+    retrieve(len);
+    return result;
+}
+
+void ChainBuffer::copyOut(size_t offset, void* dst, size_t len) const
+{
+    assert(offset + len <= readableBytes_);
+    char* out = static_cast<char*>(dst);
+
+    for (BlockList::const_iterator it = blocks_.begin(); it != blocks_.end() && len > 0; ++it) {
+        size_t readable = it->readableBytes();
+        if (offset >= readable) {
+            offset -= readable;
+            continue;
+        }
+
+        size_t n = std::min(len, readable - offset);
+        ::memcpy(out, it->data_ + it->readerIndex_ + offset, n);
+        out += n;
+        len -= n;
+        offset = 0;
+    }
+}
+
+void ChainBuffer::append(const char* /*restrict*/ data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    readableBytes_ += len;
+
+    // 先填满链尾块，再追加新块，已有的数据不移动
+    if (!blocks_.empty()) {
+        Block& tail = blocks_.back();
+        size_t n = std::min(len, tail.writableBytes());
+        ::memcpy(tail.data_ + tail.writerIndex_, data, n);
+        tail.writerIndex_ += n;
+        data += n;
+        len -= n;
+    }
+
+    while (len > 0) {
+        Block block = newBlock(kBlockSize, blocks_.empty() ? kCheapPrepend : 0);
+        size_t n = std::min(len, block.writableBytes());
+        ::memcpy(block.data_ + block.writerIndex_, data, n);
+        block.writerIndex_ += n;
+        blocks_.push_back(block);
+        data += n;
+        len -= n;
+    }
+}
+
+void ChainBuffer::prepend(const void* /*restrict*/ data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    readableBytes_ += len;
+
+    if (!blocks_.empty() && blocks_.front().readerIndex_ >= len) {
+        Block& front = blocks_.front();
+        front.readerIndex_ -= len;
+        ::memcpy(front.data_ + front.readerIndex_, data, len);
+        return;
+    }
+
+    // 数据放在新块的末尾，前面留给之后的prepend
+    Block block = newBlock(len, 0);
+    block.readerIndex_ = block.capacity_ - len;
+    block.writerIndex_ = block.capacity_;
+    ::memcpy(block.data_ + block.readerIndex_, data, len);
+    blocks_.push_front(block);
+}
+
+int ChainBuffer::peekIovec(struct iovec* iov, int maxIovecs) const
+{
+    int n = 0;
+    for (BlockList::const_iterator it = blocks_.begin(); it != blocks_.end() && n < maxIovecs; ++it) {
+        iov[n].iov_base = it->data_ + it->readerIndex_;
+        iov[n].iov_len = it->readableBytes();
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * 先读进链尾块的剩余空间，剩余空间太小(不到kMinTailRead)时再加一个新块，避免为几个字节多一次ioctl和read
+ * 读满时用ioctl(FIONREAD)查询剩余的数据量，按需要从当前线程的BufferPool取新块(最多kMaxReadBlocks块)再读一次
+ * 读入的数据不再从栈上的extrabuf拷贝一次
+ */
+ssize_t ChainBuffer::readFd(int fd, int* savedErrno)
+{
+    size_t tailWritable = blocks_.empty() ? 0 : blocks_.back().writableBytes();
+    size_t capacity = 0;
+    ssize_t n = readBlocks(fd, tailWritable < kMinTailRead ? 1 : 0, &capacity, savedErrno);
+
+    if (n > 0 && implicit_cast<size_t>(n) == capacity) {
+        int available = 0;
+        if (::ioctl(fd, FIONREAD, &available) == 0 && available > 0) {
+            size_t blocks = std::min((implicit_cast<size_t>(available) + kBlockSize - 1) / kBlockSize,
+                                     implicit_cast<size_t>(kMaxReadBlocks));
+            // 第二次读失败时只返回第一次读到的数据，错误留给下一次readFd
+            int ignoredErrno = 0;
+            ssize_t m = readBlocks(fd, static_cast<int>(blocks), &capacity, &ignoredErrno);
+            if (m > 0) {
+                n += m;
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * 一次readv(2)读入链尾块的剩余空间和freshBlocks个新块，没用上的新块立即归还
+ * *capacity为这次提供的空间
+ */
+ssize_t ChainBuffer::readBlocks(int fd, int freshBlocks, size_t* capacity, int* savedErrno)
+{
+    assert(freshBlocks <= kMaxReadBlocks);
+    struct iovec vec[1 + kMaxReadBlocks];
+    Block fresh[kMaxReadBlocks];
+    int iovcnt = 0;
+    *capacity = 0;
+
+    size_t tailWritable = blocks_.empty() ? 0 : blocks_.back().writableBytes();
+    if (tailWritable > 0) {
+        Block& tail = blocks_.back();
+        vec[iovcnt].iov_base = tail.data_ + tail.writerIndex_;
+        vec[iovcnt].iov_len = tailWritable;
+        *capacity += tailWritable;
+        ++iovcnt;
+    }
+
+    for (int i = 0; i < freshBlocks; ++i) {
+        fresh[i] = newBlock(kBlockSize, (blocks_.empty() && i == 0) ? kCheapPrepend : 0);
+        vec[iovcnt].iov_base = fresh[i].data_ + fresh[i].writerIndex_;
+        vec[iovcnt].iov_len = fresh[i].writableBytes();
+        *capacity += fresh[i].writableBytes();
+        ++iovcnt;
+    }
+
+    assert(iovcnt > 0);
+    const ssize_t n = sockets::readv(fd, vec, iovcnt);
+    size_t remaining = 0;
+
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        remaining = static_cast<size_t>(n);
+        readableBytes_ += remaining;
+    }
+
+    if (tailWritable > 0) {
+        size_t used = std::min(remaining, tailWritable);
+        blocks_.back().writerIndex_ += used;
+        remaining -= used;
+    }
+
+    for (int i = 0; i < freshBlocks; ++i) {
+        size_t used = std::min(remaining, fresh[i].writableBytes());
+        if (used > 0) {
+            fresh[i].writerIndex_ += used;
+            blocks_.push_back(fresh[i]);
+            remaining -= used;
+        } else {
+            releaseBlock(fresh[i]);
+        }
+    }
+    assert(remaining == 0);
+
+    return n;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int* savedErrno)
+{
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = peekIovec(vec, kMaxIovecs);
+
+    ssize_t n = sockets::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        retrieve(n);
+    }
+    return n;
+}
@@ -0,0 +1,306 @@
+#ifndef NETWORKER_NET_CHAINBUFFER_H
+#define NETWORKER_NET_CHAINBUFFER_H
+
+#include "networker/base/StringPiece.h"
+#include "networker/base/Types.h"
+#include "networker/net/Endian.h"
+
+#include <deque>
+#include <assert.h>
+
+struct iovec;
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * 由固定大小的块组成的链式缓冲区，接口与Buffer相同(read/peek/retrieve/append/prepend)
+     *
+     * Buffer的数据必须连续，写满时要么把可读数据memmove到前面，要么重新分配并拷贝整个缓冲区
+     * 对于几MB的流水线响应，每次扩容都是O(n)的拷贝
+     * ChainBuffer追加时只在链尾加新块，读完的块从链头移除并归还BufferPool，每块都是O(1)
+     *
+     * 代价是数据不连续: peek()只返回第一块中的数据(peekableBytes()字节)
+     * 需要跨块的连续数据时用pullup()把前len字节合并到第一块中
+     * readFd/writeFd通过readv/writev直接在多个块上读写
+     *
+     * 和Buffer一样不是线程安全的
+     */
+    class ChainBuffer
+    {
+        private:
+            struct Block
+            {
+                char* data_;
+                size_t capacity_;
+                size_t readerIndex_;
+                size_t writerIndex_;
+
+                size_t readableBytes() const
+                {
+                    return writerIndex_ - readerIndex_;
+                }
+
+                size_t writableBytes() const
+                {
+                    return capacity_ - writerIndex_;
+                }
+            };
+
+            typedef std::deque<Block> BlockList;
+
+            // 链中没有空块
+            BlockList blocks_;
+
+            size_t readableBytes_;
+
+        public:
+            static const size_t kCheapPrepend = 8;
+            static const size_t kBlockSize = 16 * 1024;
+
+            // 链尾块的剩余空间小于这个值时，readFd同时读入一个新块
+            static const size_t kMinTailRead = 4 * 1024;
+
+            // readFd读满之后按FIONREAD再读一次时最多读入的新块数
+            static const int kMaxReadBlocks = 4;
+
+            // writeFd一次最多提交的块数，不超过IOV_MAX
+            static const int kMaxIovecs = 64;
+
+            ChainBuffer(): readableBytes_(0)
+            {
+            }
+
+            ChainBuffer(const ChainBuffer& rhs);
+
+            ChainBuffer(ChainBuffer&& rhs) noexcept: readableBytes_(rhs.readableBytes_)
+            {
+                blocks_.swap(rhs.blocks_);
+                rhs.readableBytes_ = 0;
+            }
+
+            ChainBuffer& operator=(ChainBuffer rhs)
+            {
+                swap(rhs);
+                return *this;
+            }
+
+            ~ChainBuffer()
+            {
+                retrieveAll();
+            }
+
+            void swap(ChainBuffer& rhs)
+            {
+                blocks_.swap(rhs.blocks_);
+                std::swap(readableBytes_, rhs.readableBytes_);
+            }
+
+            size_t readableBytes() const
+            {
+                return readableBytes_;
+            }
+
+            size_t numBlocks() const
+            {
+                return blocks_.size();
+            }
+
+            size_t prependableBytes() const
+            {
+                return blocks_.empty() ? kCheapPrepend : blocks_.front().readerIndex_;
+            }
+
+            // 第一块中的数据，长度为peekableBytes()
+            const char* peek() const
+            {
+                return blocks_.empty() ? NULL : blocks_.front().data_ + blocks_.front().readerIndex_;
+            }
+
+            size_t peekableBytes() const
+            {
+                return blocks_.empty() ? 0 : blocks_.front().readableBytes();
+            }
+
+            /**
+             * 保证前len字节在第一块中连续，返回peek()
+             * 第一块的容量够用时只拷贝不在第一块中的数据，不够时换成一个容得下len字节的新块
+             */
+            const char* pullup(size_t len);
+
+            void retrieve(size_t len);
+
+            void retrieveAll();
+
+            void retrieveInt64()
+            {
+                retrieve(sizeof(int64_t));
+            }
+
+            void retrieveInt32()
+            {
+                retrieve(sizeof(int32_t));
+            }
+
+            void retrieveInt16()
+            {
+                retrieve(sizeof(int16_t));
+            }
+
+            void retrieveInt8()
+            {
+                retrieve(sizeof(int8_t));
+            }
+
+            string retrieveAllAsString()
+            {
+                return retrieveAsString(readableBytes());
+            }
+
+            string retrieveAsString(size_t len);
+
+            // 从offset开始拷贝len字节到dst，不移除数据
+            void copyOut(size_t offset, void* dst, size_t len) const;
+
+            void append(const char* /*restrict*/ data, size_t len);
+
+            void append(const StringPiece& str)
+            {
+                append(str.data(), str.size());
+            }
+
+            void append(const void* /*restrict*/ data, size_t len)
+            {
+                append(static_cast<const char*>(data), len);
+            }
+
+            // 第一块前面的空间不够时，在链头加一个新块
+            void prepend(const void* /*restrict*/ data, size_t len);
+
+            // 追加int64位的大端序列
+            void appendInt64(int64_t x)
+            {
+                int64_t be64 = hostToNetwork64(x);
+                append(&be64, sizeof(be64));
+            }
+
+            void appendInt32(int32_t x)
+            {
+                int32_t be32 = hostToNetwork32(x);
+                append(&be32, sizeof(be32));
+            }
+
+            void appendInt16(int16_t x)
+            {
+                int16_t be16 = hostToNetwork16(x);
+                append(&be16, sizeof(be16));
+            }
+
+            void appendInt8(int8_t x)
+            {
+                append(&x, sizeof(x));
+            }
+
+            int64_t readInt64()
+            {
+                int64_t result = peekInt64();
+                retrieveInt64();
+                return result;
+            }
+
+            int32_t readInt32()
+            {
+                int32_t result = peekInt32();
+                retrieveInt32();
+                return result;
+            }
+
+            int16_t readInt16()
+            {
+                int16_t result = peekInt16();
+                retrieveInt16();
+                return result;
+            }
+
+            int8_t readInt8()
+            {
+                int8_t result = peekInt8();
+                retrieveInt8();
+                return result;
+            }
+
+            // 整数可能跨块，逐字节拷贝出来
+            int64_t peekInt64() const
+            {
+                assert(readableBytes() >= sizeof(int64_t));
+                int64_t be64 = 0;
+                copyOut(0, &be64, sizeof(be64));
+                return networkToHost64(be64);
+            }
+
+            int32_t peekInt32() const
+            {
+                assert(readableBytes() >= sizeof(int32_t));
+                int32_t be32 = 0;
+                copyOut(0, &be32, sizeof(be32));
+                return networkToHost32(be32);
+            }
+
+            int16_t peekInt16() const
+            {
+                assert(readableBytes() >= sizeof(int16_t));
+                int16_t be16 = 0;
+                copyOut(0, &be16, sizeof(be16));
+                return networkToHost16(be16);
+            }
+
+            int8_t peekInt8() const
+            {
+                assert(readableBytes() >= sizeof(int8_t));
+                return *peek();
+            }
+
+            void prependInt64(int64_t x)
+            {
+                int64_t be64 = hostToNetwork64(x);
+                prepend(&be64, sizeof(be64));
+            }
+
+            void prependInt32(int32_t x)
+            {
+                int32_t be32 = hostToNetwork32(x);
+                prepend(&be32, sizeof(be32));
+            }
+
+            void prependInt16(int16_t x)
+            {
+                int16_t be16 = hostToNetwork16(x);
+                prepend(&be16, sizeof(be16));
+            }
+
+            void prependInt8(int8_t x)
+            {
+                prepend(&x, sizeof(x));
+            }
+
+            // 把链头部的块填入iov，返回填入的个数
+            int peekIovec(struct iovec* iov, int maxIovecs) const;
+
+            // 先读进链尾块的剩余空间，读满时按FIONREAD取需要的新块再读一次，见ChainBuffer.cpp
+            ssize_t readFd(int fd, int* savedErrno);
+
+            // 一次writev(2)写出链头部的块，并移除已写出的部分
+            ssize_t writeFd(int fd, int* savedErrno);
+
+        private:
+            ssize_t readBlocks(int fd, int freshBlocks, size_t* capacity, int* savedErrno);
+
+            static Block newBlock(size_t minSize, size_t readerIndex);
+
+            static void releaseBlock(Block& block);
+    };
+};
+};
+
+#endif
@@ -15,7 +15,7 @@ const int Channel::kWriteEvent = POLLOUT;
 
 Channel::Channel(EventLoop *loop, int fd__)
     :loop_(loop), fd_(fd__), events_(0), revents_(0),
-    index_(-1), logHup_(true), tied_(false), eventHandling_(false), addedToLoop_(false)
+    index_(-1), logHup_(true), exclusive_(false), edgeTriggered_(false), completionMode_(kNoCompletion), tied_(false), eventHandling_(false), addedToLoop_(false)
 {
 }
 
@@ -3,7 +3,8 @@
 
 #include "networker/base/noncopyable.h"
 #include "networker/base/Timestamp.h"
-#include <functional>
+#include "networker/base/InplaceFunction.h"
+
 #include <memory>
 
 namespace networker
@@ -28,8 +29,20 @@ namespace net
     class Channel: noncopyable
     {
         public:
-            typedef std::function<void()> EventCallback;
-            typedef std::function<void(Timestamp)> ReadEventCallback;
+            typedef InplaceFunction<void()> EventCallback;
+            typedef InplaceFunction<void(Timestamp)> ReadEventCallback;
+
+            /**
+             * 完成模式(见Poller::supportsCompletionIo): 关注可读事件时Poller不等待就绪，而是直接提交multishot recv/accept
+             * 收到数据(连接)时回调ReadCallback，由使用者通过EventLoop::takeReceived/takeAccepted取出
+             * 可写事件仍然是就绪通知，另外EventLoop::submitSend的完成也以可写事件回调
+             */
+            enum CompletionMode
+            {
+                kNoCompletion,
+                kRecvCompletion,
+                kAcceptCompletion,
+            };
 
         private:
             // Channel的成员函数都只能在IO线程调用，因此更新数据成员都不必加锁
@@ -51,6 +64,12 @@ namespace net
 
             bool logHup_;
 
+            bool exclusive_;    // 注册到epoll时带上EPOLLEXCLUSIVE
+
+            bool edgeTriggered_;    // 边沿触发
+
+            CompletionMode completionMode_;
+
             std::weak_ptr<void> tie_;
 
             bool tied_;
@@ -145,6 +164,13 @@ namespace net
                 update(); 
             }
 
+            // 只更新一次Poller
+            void enableReadingAndWriting()
+            {
+                events_ |= kReadEvent | kWriteEvent;
+                update();
+            }
+
             void disableAll() 
             { 
                 events_ = kNoneEvent; 
@@ -182,6 +208,46 @@ namespace net
                 logHup_ = false;
             }
 
+            /**
+             * 多个EventLoop等待同一个fd时(例如共享的监听socket)，事件就绪只唤醒其中一个，避免惊群
+             * 只有EPollPoller支持，必须在第一次enable之前设置
+             * 内核不允许修改(EPOLL_CTL_MOD)带有EPOLLEXCLUSIVE的注册，之后只能在disableAll和enable之间切换
+             */
+            void setExclusive(bool on)
+            {
+                exclusive_ = on;
+            }
+
+            bool isExclusive() const
+            {
+                return exclusive_;
+            }
+
+            /**
+             * 边沿触发: 只在fd从未就绪变为就绪时通知一次，使用者必须读/写到EAGAIN为止
+             * 只有Poller::supportsEdgeTriggered()的后端支持(见EventLoop::supportsEdgeTriggered)，必须在第一次enable之前设置
+             */
+            void setEdgeTriggered(bool on)
+            {
+                edgeTriggered_ = on;
+            }
+
+            bool isEdgeTriggered() const
+            {
+                return edgeTriggered_;
+            }
+
+            // 只有EventLoop::supportsCompletionIo()的后端支持，必须在第一次enable之前设置
+            void setCompletionMode(CompletionMode mode)
+            {
+                completionMode_ = mode;
+            }
+
+            CompletionMode completionMode() const
+            {
+                return completionMode_;
+            }
+
             EventLoop* ownerLoop() 
             { 
                 return loop_;
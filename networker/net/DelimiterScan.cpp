@@ -0,0 +1,107 @@
+#include "networker/net/DelimiterScan.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define NETWORKER_SCAN_X86 1
+#endif
+
+using namespace networker;
+using namespace networker::net;
+
+namespace
+{
+    typedef const char* (*FindCRLFFunc)(const char*, const char*);
+
+    // memchr找'\r'，再看下一个字节是不是'\n'
+    const char* findCRLFScalar(const char* begin, const char* end)
+    {
+        const char* p = begin;
+        while (end - p >= 2) {
+            const char* cr = static_cast<const char*>(memchr(p, '\r', end - p - 1));
+            if (cr == NULL) {
+                return NULL;
+            }
+            if (cr[1] == '\n') {
+                return cr;
+            }
+            p = cr + 1;
+        }
+        return NULL;
+    }
+
+#ifdef NETWORKER_SCAN_X86
+    /**
+     * 错开一个字节加载两次，p[i] == '\r'和p[i + 1] == '\n'的比较结果按位与，第一个置位的就是CRLF
+     * 第二次加载要多读一个字节，所以剩余不足一个向量加一个字节时交给标量实现
+     */
+    const char* findCRLFSse2(const char* begin, const char* end)
+    {
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i lf = _mm_set1_epi8('\n');
+        const char* p = begin;
+        while (end - p >= 17) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 1));
+            unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, cr), _mm_cmpeq_epi8(b, lf)));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 16;
+        }
+        return findCRLFScalar(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* findCRLFAvx2(const char* begin, const char* end)
+    {
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i lf = _mm256_set1_epi8('\n');
+        const char* p = begin;
+        while (end - p >= 33) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 1));
+            unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, cr), _mm256_cmpeq_epi8(b, lf)));
+            if (mask != 0) {
+                return p + __builtin_ctz(mask);
+            }
+            p += 32;
+        }
+        return findCRLFScalar(p, end);
+    }
+#endif
+
+    // 静态初始化之前是标量实现，其它全局对象的构造函数中使用Buffer也是安全的
+    FindCRLFFunc g_findCRLF = findCRLFScalar;
+    const char* g_kernelName = "scalar";
+
+    struct KernelSelector
+    {
+        KernelSelector()
+        {
+#ifdef NETWORKER_SCAN_X86
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx2")) {
+                g_findCRLF = findCRLFAvx2;
+                g_kernelName = "avx2";
+            } else {
+                g_findCRLF = findCRLFSse2;
+                g_kernelName = "sse2";
+            }
+#endif
+        }
+    };
+
+    KernelSelector kernelSelector;
+};
+
+const char* scan::findCRLF(const char* begin, const char* end)
+{
+    return g_findCRLF(begin, end);
+}
+
+const char* scan::kernelName()
+{
+    return g_kernelName;
+}
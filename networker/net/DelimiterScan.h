@@ -0,0 +1,24 @@
+#ifndef NETWORKER_NET_DELIMITERSCAN_H
+#define NETWORKER_NET_DELIMITERSCAN_H
+
+namespace networker
+{
+namespace net
+{
+namespace scan
+{
+
+    /**
+     * 在[begin, end)中查找第一个"\r\n"，返回'\r'的位置，没有时返回NULL
+     * x86-64上程序启动时按CPU选择AVX2或者SSE2的实现，每次比较32/16个字节，其它平台使用memchr
+     */
+    const char* findCRLF(const char* begin, const char* end);
+
+    // 当前使用的实现，"avx2", "sse2" 或者 "scalar"
+    const char* kernelName();
+
+};
+};
+};
+
+#endif
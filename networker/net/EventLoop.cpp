@@ -1,10 +1,12 @@
 #include "networker/net/EventLoop.h"
 #include "networker/base/Logging.h"
-#include "networker/base/MutexLock.h"
+#include "networker/net/BufferPool.h"
 #include "networker/net/Channel.h"
+#include "networker/net/EventLoopStats.h"
 #include "networker/net/Poller.h"
 #include "networker/net/SocketsOps.h"
 #include "networker/net/TimerQueue.h"
+#include "networker/net/TimingWheel.h"
 
 #include <algorithm>
 #include <signal.h>
@@ -20,6 +22,9 @@ namespace
 
     const int kPollTimeMs = 10000;
 
+    // busyPermille的统计周期
+    const int64_t kBusyWindowUs = 100 * 1000;
+
     int createEventfd()
     {
         /**
@@ -46,6 +51,14 @@ namespace
     #pragma GCC diagnostic error "-Wold-style-cast"
 
     IgnoreSigPipe initObj;
+
+    TimerBackend resolveTimerBackend(TimerBackend backend)
+    {
+        if (backend == kDefaultTimerBackend) {
+            return ::getenv("NETWORKER_USE_TIMING_WHEEL") ? kTimingWheel : kTimerQueue;
+        }
+        return backend;
+    }
 };
 /**
  * 每个线程至多有一个EventLoop对象，那么使用getEventLoopOfCurrentThread返回这个对象
@@ -60,17 +73,21 @@ EventLoop* EventLoop::getEventLoopOfCurrentThread()
  * EventLoop的构造函数会记住本对象所属的线程(threadId_)
  * 创建了EventLoop对象的线程是IO线程，其主要功能是运行事件循环
  */
-EventLoop::EventLoop()
-    : looping_(false), quit_(false), eventHandling_(false), iteration_(0),
-    threadId_(CurrentThread::tid()), poller_(Poller::newDefaultPoller(this)),
-    timerQueue_(new TimerQueue(this)), wakeupFd_(createEventfd()),
-    wakeupChannel_(new Channel(this, wakeupFd_)), currentActiveChannel_(NULL)
+EventLoop::EventLoop(TimerBackend timerBackend)
+    : looping_(false), quit_(false), eventHandling_(false), sleeping_(false), iteration_(0),
+    threadId_(CurrentThread::tid()), bufferPool_(new BufferPool), poller_(Poller::newDefaultPoller(this)),
+    timerQueue_(resolveTimerBackend(timerBackend) == kTimerQueue ? new TimerQueue(this) : NULL),
+    timingWheel_(timerQueue_ ? NULL : new TimingWheel(this)), wakeupFd_(createEventfd()),
+    wakeupChannel_(new Channel(this, wakeupFd_)), currentActiveChannel_(NULL), numConnections_(0),
+    busyPermille_(0), busyWindowStartUs_(Timestamp::now().microSecondsSinceEpoch()), busyInWindowUs_(0),
+    statsEnabled_(false), stats_(new EventLoopStats)
 {
     LOG_DEBUG << "EventLoop created " << this << " in thread " << threadId_;
     if (t_loopInThisThread) {
         LOG_FATAL << "Another EventLoop " << t_loopInThisThread << " exists in this thread " << threadId_;
     } else {
         t_loopInThisThread = this;
+        BufferPool::setThreadPool(bufferPool_.get());
     }
 
     wakeupChannel_->setReadCallback(std::bind(&EventLoop::handleRead, this));
@@ -85,6 +102,8 @@ EventLoop::~EventLoop()
     wakeupChannel_->remove();
     ::close(wakeupFd_);
     t_loopInThisThread = NULL;
+    // 之后(包括成员析构时)释放的存储块直接free
+    BufferPool::setThreadPool(NULL);
 }
 
 void EventLoop::loop()
@@ -95,28 +114,66 @@ void EventLoop::loop()
     quit_ = false;
     LOG_TRACE << "EventLoop " << this << " start looping";
 
+    Timestamp iterationEnd(Timestamp::now());
     while (!quit_) {
         activeChannels_.clear();
+        const bool recordStats = statsEnabled();
+
+        /**
+         * 先声明自己要睡眠，再检查队列。与queueInLoop中先入队再检查sleeping_配对
+         * 两边都是顺序一致的原子操作，所以至少有一方能看到对方: 要么这里看到新的functor不阻塞，要么生产者看到sleeping_去唤醒
+         */
+        sleeping_.store(true);
+        int timeoutMs = pendingFunctors_.empty() ? kPollTimeMs : 0;
+
         // 监听文件描述符注册的事件
-        pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
+        pollReturnTime_ = poller_->poll(timeoutMs, &activeChannels_);
+        sleeping_.store(false);
         ++iteration_;
 
         if (Logger::logLevel() <= Logger::TRACE) {
             printActiveChannels();
         }
 
+        // 统计时每个阶段的开始时间就是上一个阶段的结束时间，每个回调只多一次Timestamp::now()
+        int64_t lastUs = pollReturnTime_.microSecondsSinceEpoch();
+        if (recordStats) {
+            stats_->recordPoll(lastUs - iterationEnd.microSecondsSinceEpoch());
+        }
+
         eventHandling_ = true;
         for (Channel *channel: activeChannels_) {
             currentActiveChannel_ = channel;
+            // 回调中Channel可能被移除，先记下fd
+            const int fd = channel->fd();
             currentActiveChannel_->handleEvent(pollReturnTime_);
+            if (recordStats) {
+                int64_t nowUs = Timestamp::now().microSecondsSinceEpoch();
+                stats_->recordCallback(fd, nowUs - lastUs);
+                lastUs = nowUs;
+            }
         }
 
         currentActiveChannel_ = NULL;
         eventHandling_ = false;
         // 队列事件触发
-        doPendingFunctors();
+        size_t functors = doPendingFunctors();
+        iterationEnd = Timestamp::now();
+        if (recordStats) {
+            if (functors > 0) {
+                stats_->recordFunctors(functors, iterationEnd.microSecondsSinceEpoch() - lastUs);
+            }
+            stats_->endIteration(iterationEnd.microSecondsSinceEpoch());
+        }
+        updateBusyTime(iterationEnd);
     }
 
+    /**
+     * quit()之前投递的functor可能还没来得及执行(例如TcpServer析构时投递的connectDestroyed)
+     * 退出前再执行一轮，否则它们持有的TcpConnectionPtr要到EventLoop析构时才释放，此时连接还没有断开
+     */
+    doPendingFunctors();
+
     LOG_TRACE << "EventLoop " << this << " stop looping";
     looping_ = false;
 }
@@ -144,38 +201,66 @@ void EventLoop::runInLoop(Functor cb)
 
 /**
  * 流程
- *  1. 加锁，然后将该函数放到该EventLoop的pendingFunctors_队列中
+ *  1. 将该函数放到该EventLoop的无锁队列pendingFunctors_中
  *  2. 判断是否要唤醒EventLoop，如果是则调用wakeup()唤醒该EventLoop
  * 
  * 为什么要唤醒EventLoop?
- *  1. 调用了pendingFunctors_.push_back(cb);, 将该函数放在pendingFunctors_中.
- *      EventLoop的每一轮循环最后会调用doPendingFunctors依次执行这些函数
+ *  1. EventLoop的每一轮循环最后会调用doPendingFunctors依次执行这些函数
  *  
  *  2. 而EventLoop的唤醒是通过epoll_wait实现的，如果此时该EventLoop中迟迟没有事件触发，那么epoll_wait一直就会阻塞
  *      这样会导致，pengdingFunctors迟迟不能被执行了。所以唤醒EventLoop是必须的
+ *
+ * 唤醒合并
+ *  1. 只有EventLoop真正阻塞在poll中(sleeping_为true)时才需要写wakeupFd_
+ *      多个线程同时投递时，只有把sleeping_从true交换成false的那个线程去写，其余的都省掉了这次系统调用
+ *  2. 在IO线程中调用时不需要唤醒，loop()在进入poll之前会检查队列是否为空
  */
 void EventLoop::queueInLoop(Functor cb)
 {
-    // 减少锁范围
-    {
-        MutexLockGuard lock(mutex_);
-        pendingFunctors_.push_back(std::move(cb));
-    }
+    pendingFunctors_.push(std::move(cb));
 
-    if (!isInLoopThread() || callingPendingFunctors_) {
+    if (!isInLoopThread() && sleeping_.load() && sleeping_.exchange(false)) {
         wakeup();
     }
 }
 
+// 从poll返回到这一轮结束都算作忙碌
+void EventLoop::updateBusyTime(Timestamp iterationEnd)
+{
+    const int64_t end = iterationEnd.microSecondsSinceEpoch();
+    busyInWindowUs_ += end - pollReturnTime_.microSecondsSinceEpoch();
+    int64_t window = end - busyWindowStartUs_.load(std::memory_order_relaxed);
+    if (window >= kBusyWindowUs) {
+        busyPermille_.store(static_cast<int>(std::min(busyInWindowUs_ * 1000 / window, implicit_cast<int64_t>(1000))),
+            std::memory_order_relaxed);
+        busyWindowStartUs_.store(end, std::memory_order_relaxed);
+        busyInWindowUs_ = 0;
+    }
+}
+
+int EventLoop::busyPermille() const
+{
+    int busy = busyPermille_.load(std::memory_order_relaxed);
+    if (busy > 0 && sleeping_.load(std::memory_order_relaxed)) {
+        int64_t idle = Timestamp::now().microSecondsSinceEpoch() - busyWindowStartUs_.load(std::memory_order_relaxed);
+        if (idle > kBusyWindowUs) {
+            busy = static_cast<int>(busy * kBusyWindowUs / idle);
+        }
+    }
+    return busy;
+}
+
 size_t EventLoop::queueSize() const
 {
-    MutexLockGuard lock(mutex_);
     return pendingFunctors_.size();
 }
 
 // 在指定的时间调用TimerCallback
 TimerId EventLoop::runAt(Timestamp time, TimerCallback cb)
 {
+    if (timingWheel_) {
+        return timingWheel_->addTimer(std::move(cb), time, 0.0);
+    }
     return timerQueue_->addTimer(std::move(cb), time, 0.0);
 }
 
@@ -190,13 +275,31 @@ TimerId EventLoop::runAfter(double delay, TimerCallback cb)
 TimerId EventLoop::runEvery(double interval, TimerCallback cb)
 {
     Timestamp time(addTime(Timestamp::now(), interval));
+    if (timingWheel_) {
+        return timingWheel_->addTimer(std::move(cb), time, interval);
+    }
     return timerQueue_->addTimer(std::move(cb), time, interval);
 }
 
 // 取消timer
 void EventLoop::cancel(TimerId timerId)
 {
-    return timerQueue_->cancel(timerId);
+    if (timingWheel_) {
+        timingWheel_->cancel(timerId);
+    } else {
+        timerQueue_->cancel(timerId);
+    }
+}
+
+// 推迟timer
+void EventLoop::refresh(TimerId timerId, double delay)
+{
+    Timestamp time(addTime(Timestamp::now(), delay));
+    if (timingWheel_) {
+        timingWheel_->refresh(timerId, time);
+    } else {
+        timerQueue_->refresh(timerId, time);
+    }
 }
 
 void EventLoop::updateChannel(Channel *channel)
@@ -225,6 +328,44 @@ bool EventLoop::hasChannel(Channel *channel)
     return poller_->hasChannel(channel);
 }
 
+bool EventLoop::supportsEdgeTriggered() const
+{
+    return poller_->supportsEdgeTriggered();
+}
+
+bool EventLoop::supportsCompletionIo() const
+{
+    return poller_->supportsCompletionIo();
+}
+
+ssize_t EventLoop::takeReceived(Channel *channel, Buffer *buf, int *savedErrno)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    return poller_->takeReceived(channel, buf, savedErrno);
+}
+
+int EventLoop::takeAccepted(Channel *channel, int *savedErrno)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    return poller_->takeAccepted(channel, savedErrno);
+}
+
+void EventLoop::submitSend(Channel *channel, const struct iovec *iov, int iovcnt, std::shared_ptr<const void> holder)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    poller_->submitSend(channel, iov, iovcnt, std::move(holder));
+}
+
+bool EventLoop::takeSendResult(Channel *channel, ssize_t *result)
+{
+    assert(channel->ownerLoop() == this);
+    assertInLoopThread();
+    return poller_->takeSendResult(channel, result);
+}
+
 void EventLoop::abortNotInLoopThread()
 {
     LOG_FATAL << "EventLoop::abortNotInLoopThread - EventLoop " << this
@@ -259,21 +400,28 @@ void EventLoop::handleRead()
     }
 }
 
-void EventLoop::doPendingFunctors()
+/**
+ * 只执行本轮开始时已经在队列中的functor
+ * functor中再调用queueInLoop加入的functor留到下一轮，避免一直不回到poll
+ */
+size_t EventLoop::doPendingFunctors()
 {
-    std::vector<Functor> functors;
-    callingPendingFunctors_ = true;
+    size_t n = pendingFunctors_.size();
+    size_t done = 0;
+    Functor functor;
 
-    // 缩小锁范围
-    {
-        MutexLockGuard lock(mutex_);
-        functors.swap(pendingFunctors_);
+    while (done < n && pendingFunctors_.pop(&functor)) {
+        functor();
+        ++done;
     }
+    return done;
+}
 
-    for (const Functor& functor: functors) {
-        functor();
+void EventLoop::recordTimerFired(Timestamp expiration, Timestamp now)
+{
+    if (statsEnabled()) {
+        stats_->recordTimerLateness(now.microSecondsSinceEpoch() - expiration.microSecondsSinceEpoch());
     }
-    callingPendingFunctors_ = false;
 }
 
 void EventLoop::printActiveChannels() const
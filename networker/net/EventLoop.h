@@ -7,26 +7,33 @@
 #include <any>
 #include <utility>
 
-#include "networker/base/MutexLock.h"
 #include "networker/base/CurrentThread.h"
+#include "networker/base/MpscQueue.h"
 #include "networker/base/Timestamp.h"
 #include "networker/net/Callbacks.h"
 #include "networker/net/TimerId.h"
 
+struct iovec;
+
 namespace networker
 {
 namespace net
 {
+    class Buffer;
+    class BufferPool;
     class Channel;
+    class EventLoopStats;
     class Poller;
     class TimerQueue;
+    class TimingWheel;
 
     // Reactor, 每个线程最多一个
     // 接口类
     class EventLoop
     {
         public:
-            typedef std::function<void()> Functor;
+            // 投递到IO线程的任务，常见的bind表达式和lambda都放得进内部存储，入队时不分配内存
+            typedef InplaceFunction<void()> Functor;
         
         private:
             typedef std::vector<Channel*> ChannelList;
@@ -37,7 +44,8 @@ namespace net
 
             bool eventHandling_;    // atomic
 
-            bool callingPendingFunctors_;   // atomic
+            // 阻塞在poll中(或即将进入poll)时为true，其它线程只有看到true时才需要写wakeupFd_
+            std::atomic<bool> sleeping_;
 
             int64_t iteration_;
 
@@ -45,10 +53,16 @@ namespace net
 
             Timestamp pollReturnTime_;
 
+            // 本线程中Buffer的存储块缓存
+            std::unique_ptr<BufferPool> bufferPool_;
+
             std::unique_ptr<Poller> poller_;
 
+            // 两者只会创建其中一个，由构造时的TimerBackend决定
             std::unique_ptr<TimerQueue> timerQueue_;
 
+            std::unique_ptr<TimingWheel> timingWheel_;
+
             int wakeupFd_;  // epollfd
 
             /**
@@ -63,12 +77,25 @@ namespace net
 
             Channel* currentActiveChannel_;
 
-            mutable MutexLock mutex_;
+            MpscQueue<Functor> pendingFunctors_;
+
+            // 分配给这个EventLoop、还没有销毁的TcpConnection数
+            std::atomic<int> numConnections_;
+
+            // 最近一个统计周期内，处理事件、定时器和functor的时间占比(千分比)
+            std::atomic<int> busyPermille_;
+
+            // 当前统计周期的开始时间(微秒)，其它线程读取busyPermille时用来判断IO线程空闲了多久
+            std::atomic<int64_t> busyWindowStartUs_;
+
+            int64_t busyInWindowUs_;
 
-            std::vector<Functor> pendingFunctors_;
+            std::atomic<bool> statsEnabled_;
+
+            std::unique_ptr<EventLoopStats> stats_;
         
         public:
-            EventLoop();
+            explicit EventLoop(TimerBackend timerBackend = kDefaultTimerBackend);
 
             ~EventLoop();
 
@@ -108,8 +135,33 @@ namespace net
              */
             void queueInLoop(Functor cb);
 
+            // 不加锁，可以在任意线程调用
             size_t queueSize() const;
 
+            // 不加锁，可以在任意线程调用
+            int numConnections() const
+            {
+                return numConnections_.load(std::memory_order_relaxed);
+            }
+
+            // 由TcpConnection的构造函数(在分配连接的线程中)和connectDestroyed(在本IO线程中)调用
+            void connectionCreated()
+            {
+                numConnections_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void connectionDestroyed()
+            {
+                numConnections_.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            /**
+             * 最近一个统计周期(至少100ms)内不在poll中阻塞的时间占比，0到1000
+             * 周期在每轮循环结束时滚动，IO线程阻塞在poll中超过一个周期时，按空闲的时长折算上一个周期的值
+             * 不加锁，可以在任意线程调用
+             */
+            int busyPermille() const;
+
             /**
              * 在“time”运行回调
              * 从其他线程调用是安全的
@@ -134,11 +186,66 @@ namespace net
              */
             void cancel(TimerId timerId);
 
+            /**
+             * 把计时器推迟到delay秒之后到期，用于空闲连接踢出这类需要频繁刷新的计时器
+             * 使用kTimingWheel时，在IO线程中调用是O(1)的
+             * 从其他线程调用是安全的
+             */
+            void refresh(TimerId timerId, double delay);
+
+            TimerBackend timerBackend() const
+            {
+                return timingWheel_ ? kTimingWheel : kTimerQueue;
+            }
+
             void wakeup();
             void updateChannel(Channel *channel);
             void removeChannel(Channel *channel);
             bool hasChannel(Channel *channel);
 
+            // Poller是否支持边沿触发的Channel
+            bool supportsEdgeTriggered() const;
+
+            // Poller是否支持完成模式的Channel，以下几个函数见Poller中的同名函数，只能在IO线程调用
+            bool supportsCompletionIo() const;
+
+            ssize_t takeReceived(Channel *channel, Buffer *buf, int *savedErrno);
+
+            int takeAccepted(Channel *channel, int *savedErrno);
+
+            void submitSend(Channel *channel, const struct iovec *iov, int iovcnt, std::shared_ptr<const void> holder);
+
+            bool takeSendResult(Channel *channel, ssize_t *result);
+
+            /**
+             * 开启后在loop中记录poll、Channel回调、functor和定时器的耗时，见EventLoopStats
+             * 每个活跃Channel多一次Timestamp::now()，默认关闭，可以在任意线程调用
+             */
+            void setStatsEnabled(bool on)
+            {
+                statsEnabled_.store(on, std::memory_order_relaxed);
+            }
+
+            bool statsEnabled() const
+            {
+                return statsEnabled_.load(std::memory_order_relaxed);
+            }
+
+            // 可以在任意线程中读取
+            const EventLoopStats& stats() const
+            {
+                return *stats_;
+            }
+
+            // 由TimerQueue和TimingWheel在IO线程中调用
+            void recordTimerFired(Timestamp expiration, Timestamp now);
+
+            // 只能在IO线程中使用
+            BufferPool* bufferPool() const
+            {
+                return bufferPool_.get();
+            }
+
             // 判断是不是同一个线程
             void assertInLoopThread()
             {
@@ -180,7 +287,10 @@ namespace net
 
             void handleRead();  // wake up
 
-            void doPendingFunctors();
+            // 返回执行的functor数
+            size_t doPendingFunctors();
+
+            void updateBusyTime(Timestamp iterationEnd);
 
             void printActiveChannels() const;   //DEBUG
     };
@@ -0,0 +1,111 @@
+#include "networker/net/EventLoopStats.h"
+
+#include <stdio.h>
+
+using namespace networker;
+using namespace networker::net;
+
+const int LogHistogram::kNumBuckets;
+const int64_t EventLoopStats::kSlowestIntervalUs;
+
+namespace
+{
+    // 没有回调的周期
+    const uint64_t kNoSlowCallback = static_cast<uint64_t>(static_cast<uint32_t>(-1)) << 32;
+
+    void appendHistogram(string* out, const char* name, const LogHistogram& h)
+    {
+        char buf[160];
+        snprintf(buf, sizeof buf, "%s{n=%lld avg=%.1f p50=%lld p99=%lld max=%lld} ", name,
+            static_cast<long long>(h.count()), h.mean(), static_cast<long long>(h.percentile(0.5)),
+            static_cast<long long>(h.percentile(0.99)), static_cast<long long>(h.max()));
+        out->append(buf);
+    }
+};
+
+LogHistogram::LogHistogram(): count_(0), sum_(0), max_(0)
+{
+    for (int i = 0; i < kNumBuckets; ++i) {
+        buckets_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+double LogHistogram::mean() const
+{
+    int64_t n = count();
+    return n == 0 ? 0.0 : static_cast<double>(sum()) / static_cast<double>(n);
+}
+
+int64_t LogHistogram::percentile(double q) const
+{
+    int64_t counts[kNumBuckets];
+    int64_t total = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        counts[i] = bucket(i);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    int64_t rank = static_cast<int64_t>(q * static_cast<double>(total) + 0.5);
+    rank = std::max(rank, implicit_cast<int64_t>(1));
+    int64_t seen = 0;
+    for (int i = 0; i < kNumBuckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(bucketLimit(i) - 1, max());
+        }
+    }
+    return max();
+}
+
+EventLoopStats::EventLoopStats()
+    : lastSlowest_(kNoSlowCallback), intervalStartUs_(0), currentSlowestFd_(-1), currentSlowestUs_(-1)
+{
+}
+
+EventLoopStats::SlowCallback EventLoopStats::slowestCallback() const
+{
+    uint64_t packed = lastSlowest_.load(std::memory_order_relaxed);
+    SlowCallback slowest = { static_cast<int>(static_cast<uint32_t>(packed >> 32)),
+                             static_cast<int64_t>(packed & 0xFFFFFFFFu) };
+    return slowest;
+}
+
+void EventLoopStats::endIteration(int64_t nowUs)
+{
+    if (intervalStartUs_ == 0) {
+        intervalStartUs_ = nowUs;
+    }
+    if (nowUs - intervalStartUs_ < kSlowestIntervalUs) {
+        return;
+    }
+
+    uint64_t packed = kNoSlowCallback;
+    if (currentSlowestFd_ >= 0) {
+        int64_t us = std::min(currentSlowestUs_, implicit_cast<int64_t>(UINT32_MAX));
+        packed = (static_cast<uint64_t>(static_cast<uint32_t>(currentSlowestFd_)) << 32) | static_cast<uint64_t>(us);
+    }
+    lastSlowest_.store(packed, std::memory_order_relaxed);
+
+    intervalStartUs_ = nowUs;
+    currentSlowestFd_ = -1;
+    currentSlowestUs_ = -1;
+}
+
+string EventLoopStats::toString() const
+{
+    string out;
+    appendHistogram(&out, "poll", pollTime_);
+    appendHistogram(&out, "callback", callbackTime_);
+    appendHistogram(&out, "functor", functorTime_);
+    appendHistogram(&out, "batch", functorsPerBatch_);
+    appendHistogram(&out, "timerLate", timerLateness_);
+
+    SlowCallback slowest = slowestCallback();
+    char buf[64];
+    snprintf(buf, sizeof buf, "slowest{fd=%d us=%lld}", slowest.fd, static_cast<long long>(slowest.microseconds));
+    out.append(buf);
+    return out;
+}
@@ -0,0 +1,190 @@
+#ifndef NETWORKER_NET_EVENTLOOPSTATS_H
+#define NETWORKER_NET_EVENTLOOPSTATS_H
+
+#include "networker/base/noncopyable.h"
+#include "networker/base/Types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * 以2为底对数分桶的直方图: 第0个桶统计0，第i个桶统计[2^(i-1), 2^i)，最后一个桶包含所有更大的值
+     *
+     * 只有一个写者(IO线程)，用relaxed的load + store更新，不需要原子的读-改-写指令
+     * 其它线程可以随时无锁地读取，但各个计数之间不是同一时刻的快照
+     */
+    class LogHistogram: noncopyable
+    {
+        public:
+            static const int kNumBuckets = 32;
+
+        private:
+            std::atomic<int64_t> buckets_[kNumBuckets];
+            std::atomic<int64_t> count_;
+            std::atomic<int64_t> sum_;
+            std::atomic<int64_t> max_;
+
+        public:
+            LogHistogram();
+
+            // 只能在写者线程中调用
+            void record(int64_t value)
+            {
+                if (value < 0) {
+                    value = 0;
+                }
+                int i = value == 0 ? 0 : std::min(64 - __builtin_clzll(value), kNumBuckets - 1);
+                add(&buckets_[i], 1);
+                add(&count_, 1);
+                add(&sum_, value);
+                if (value > max_.load(std::memory_order_relaxed)) {
+                    max_.store(value, std::memory_order_relaxed);
+                }
+            }
+
+            int64_t count() const
+            {
+                return count_.load(std::memory_order_relaxed);
+            }
+
+            int64_t sum() const
+            {
+                return sum_.load(std::memory_order_relaxed);
+            }
+
+            int64_t max() const
+            {
+                return max_.load(std::memory_order_relaxed);
+            }
+
+            int64_t bucket(int i) const
+            {
+                return buckets_[i].load(std::memory_order_relaxed);
+            }
+
+            // 第i个桶的上界(不含)
+            static int64_t bucketLimit(int i)
+            {
+                return i == 0 ? 1 : implicit_cast<int64_t>(1) << i;
+            }
+
+            double mean() const;
+
+            // 近似的分位数，q在(0, 1]之间，返回所在桶的上界，不超过max()
+            int64_t percentile(double q) const;
+
+        private:
+            static void add(std::atomic<int64_t>* counter, int64_t delta)
+            {
+                counter->store(counter->load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+            }
+    };
+
+    /**
+     * EventLoop的统计，由IO线程在EventLoop::loop中记录，其它线程(例如统计接口)无锁读取
+     * 时间的单位都是微秒
+     */
+    class EventLoopStats: noncopyable
+    {
+        public:
+            struct SlowCallback
+            {
+                int fd;                 // 没有回调时为-1
+                int64_t microseconds;
+            };
+
+            // 统计最慢回调的周期
+            static const int64_t kSlowestIntervalUs = 1000 * 1000;
+
+        private:
+            LogHistogram pollTime_;
+            LogHistogram callbackTime_;
+            LogHistogram functorTime_;
+            LogHistogram functorsPerBatch_;
+            LogHistogram timerLateness_;
+
+            // 上一个周期中最慢的Channel回调，高32位是fd，低32位是微秒数，一次读出保证两者是一致的
+            std::atomic<uint64_t> lastSlowest_;
+
+            // 以下只在IO线程中访问
+            int64_t intervalStartUs_;
+            int currentSlowestFd_;
+            int64_t currentSlowestUs_;
+
+        public:
+            EventLoopStats();
+
+            // 每次poll阻塞的时间
+            const LogHistogram& pollTime() const
+            {
+                return pollTime_;
+            }
+
+            // 每个活跃Channel的handleEvent的时间
+            const LogHistogram& callbackTime() const
+            {
+                return callbackTime_;
+            }
+
+            // 每次doPendingFunctors的时间，没有functor时不记录
+            const LogHistogram& functorTime() const
+            {
+                return functorTime_;
+            }
+
+            // 每次doPendingFunctors执行的functor数，没有functor时不记录
+            const LogHistogram& functorsPerBatch() const
+            {
+                return functorsPerBatch_;
+            }
+
+            // 定时器实际运行时间比到期时间晚的时间
+            const LogHistogram& timerLateness() const
+            {
+                return timerLateness_;
+            }
+
+            // 上一个完整周期(kSlowestIntervalUs)中最慢的Channel回调
+            SlowCallback slowestCallback() const;
+
+            // 一行的摘要，用于日志或者统计接口
+            string toString() const;
+
+            // 以下由IO线程调用
+            void recordPoll(int64_t us)
+            {
+                pollTime_.record(us);
+            }
+
+            void recordCallback(int fd, int64_t us)
+            {
+                callbackTime_.record(us);
+                if (us > currentSlowestUs_) {
+                    currentSlowestUs_ = us;
+                    currentSlowestFd_ = fd;
+                }
+            }
+
+            void recordFunctors(size_t n, int64_t us)
+            {
+                functorsPerBatch_.record(implicit_cast<int64_t>(n));
+                functorTime_.record(us);
+            }
+
+            void recordTimerLateness(int64_t us)
+            {
+                timerLateness_.record(us);
+            }
+
+            // 每轮循环结束时调用，周期结束时发布这个周期最慢的回调
+            void endIteration(int64_t nowUs);
+    };
+};
+};
+
+#endif
@@ -1,12 +1,17 @@
 #include "networker/net/EventLoopThread.h"
 #include "networker/net/EventLoop.h"
+#include "networker/base/Logging.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 
 using namespace networker;
 using namespace networker::net;
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const string& name)
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const string& name, TimerBackend timerBackend)
     :loop_(NULL), exiting_(false), thread_(std::bind(&EventLoopThread::threadFunc, this), name),
-    mutex_(), cond_(mutex_), callback_(cb)
+    mutex_(), cond_(mutex_), callback_(cb), timerBackend_(timerBackend)
 {
 }
 
@@ -50,7 +55,22 @@ EventLoop* EventLoopThread::startLoop()
  */
 void EventLoopThread::threadFunc()
 {
-    EventLoop loop;
+    if (!cpus_.empty()) {
+        cpu_set_t cpuSet;
+        CPU_ZERO(&cpuSet);
+        for (int cpu: cpus_) {
+            if (0 <= cpu && cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &cpuSet);
+            }
+        }
+        int err = ::pthread_setaffinity_np(::pthread_self(), sizeof cpuSet, &cpuSet);
+        if (err != 0) {
+            errno = err;
+            LOG_SYSERR << "EventLoopThread::threadFunc - pthread_setaffinity_np";
+        }
+    }
+
+    EventLoop loop(timerBackend_);
     if (callback_) {
         callback_(&loop);
     }
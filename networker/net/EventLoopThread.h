@@ -4,7 +4,9 @@
 #include "networker/base/Condition.h"
 #include "networker/base/MutexLock.h"
 #include "networker/base/Thread.h"
+#include "networker/net/TimerId.h"
 
+#include <vector>
 
 namespace networker
 {
@@ -29,12 +31,26 @@ namespace net
 
             Condition cond_;
             ThreadInitCallback callback_;
+            TimerBackend timerBackend_;
+            std::vector<int> cpus_;
         
         public:
-            EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), const string& name = string());
+            EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(), const string& name = string(),
+                TimerBackend timerBackend = kDefaultTimerBackend);
 
             ~EventLoopThread();
 
+            /**
+             * 把IO线程绑定到cpus中的CPU上，必须在startLoop之前调用
+             * 绑定在创建EventLoop之前进行，Poller、BufferPool等每个EventLoop的数据在绑定的CPU上首次访问，
+             * 按Linux默认的first-touch策略分配在该CPU所在的NUMA节点上
+             */
+            void setCpuAffinity(const std::vector<int>& cpus)
+            {
+                assert(!thread_.started());
+                cpus_ = cpus;
+            }
+
             EventLoop *startLoop();
         
         private:
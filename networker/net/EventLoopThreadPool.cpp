@@ -1,14 +1,76 @@
 #include "networker/net/EventLoopThreadPool.h"
 #include "networker/net/EventLoop.h"
 #include "networker/net/EventLoopThread.h"
+#include "networker/net/InetAddress.h"
+#include "networker/base/FileUtil.h"
+#include "networker/base/Logging.h"
 #include "stdio.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sstream>
+
 using namespace networker;
 using namespace networker::net;
 
+namespace
+{
+    /**
+     * 接收队列的中断名是 "<网卡名>-<队列名>"，队列名中含有rx或input(不区分大小写)
+     * 例如 eth0-TxRx-0, eth0-rx-1, virtio0-input.0，而eth0-tx-0, virtio0-config不是
+     */
+    bool isRxQueueIrq(const string& irqName, const string& interfaceName)
+    {
+        if (irqName.size() <= interfaceName.size() || irqName.compare(0, interfaceName.size(), interfaceName) != 0 ||
+            irqName[interfaceName.size()] != '-') {
+            return false;
+        }
+        const char* queue = irqName.c_str() + interfaceName.size() + 1;
+        return ::strcasestr(queue, "rx") != NULL || ::strcasestr(queue, "input") != NULL;
+    }
+
+    // 对端IP(不含端口)的FNV-1a哈希
+    uint64_t hashPeerIp(const InetAddress& peerAddr)
+    {
+        const unsigned char* p = NULL;
+        size_t len = 0;
+        uint32_t ip4 = 0;
+        if (peerAddr.family() == AF_INET6) {
+            const struct sockaddr_in6* addr6 = reinterpret_cast<const struct sockaddr_in6*>(peerAddr.getSockAddr());
+            p = reinterpret_cast<const unsigned char*>(&addr6->sin6_addr);
+            len = sizeof addr6->sin6_addr;
+        } else {
+            ip4 = peerAddr.ipNetEndian();
+            p = reinterpret_cast<const unsigned char*>(&ip4);
+            len = sizeof ip4;
+        }
+
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; ++i) {
+            hash = (hash ^ p[i]) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // Jump Consistent Hash (Lamping & Veach)，桶数从n变为n+1时只有1/(n+1)的key改变所在的桶
+    int jumpConsistentHash(uint64_t key, int numBuckets)
+    {
+        int64_t b = -1;
+        int64_t j = 0;
+        while (j < numBuckets) {
+            b = j;
+            key = key * 2862933555777941757ULL + 1;
+            j = static_cast<int64_t>((b + 1) * (static_cast<double>(1LL << 31) / static_cast<double>((key >> 33) + 1)));
+        }
+        return static_cast<int>(b);
+    }
+};
+
 EventLoopThreadPool::EventLoopThreadPool(EventLoop *baseLoop, const string& nameArg)
     :baseLoop_(baseLoop), name_(nameArg), started_(false),
-    numThreads_(0), next_(0)
+    numThreads_(0), next_(0), timerBackend_(kDefaultTimerBackend), dispatchPolicy_(kRoundRobin),
+    randomState_(reinterpret_cast<uintptr_t>(this) | 1)
 {
 }
 
@@ -17,6 +79,69 @@ EventLoopThreadPool::~EventLoopThreadPool()
     // 不要删除循环，这是堆栈变量
 }
 
+std::vector<int> EventLoopThreadPool::nicQueueCpus(const string& interfaceName)
+{
+    std::vector<int> cpus;
+
+    // virtio等网卡的中断以设备名(/sys/class/net/<网卡名>/device的链接目标)命名，例如virtio3-input.0
+    string deviceName;
+    char path[256];
+    char link[256];
+    snprintf(path, sizeof path, "/sys/class/net/%s/device", interfaceName.c_str());
+    ssize_t n = ::readlink(path, link, sizeof link - 1);
+    if (n > 0) {
+        link[n] = '\0';
+        const char* slash = ::strrchr(link, '/');
+        deviceName = slash != NULL ? slash + 1 : link;
+    }
+
+    string interrupts;
+    readFile("/proc/interrupts", 4 * 1024 * 1024, &interrupts);
+
+    // 每行的格式: " 45:  计数(每个CPU一列) ... 中断控制器 ... 中断名"
+    std::istringstream lines(interrupts);
+    string line;
+    while (std::getline(lines, line)) {
+        string::size_type colon = line.find(':');
+        string::size_type nameBegin = line.find_last_of(" \t");
+        if (colon == string::npos || nameBegin == string::npos) {
+            continue;
+        }
+        char* end = NULL;
+        long irq = ::strtol(line.c_str(), &end, 10);
+        const string irqName = line.substr(nameBegin + 1);
+        if (end != line.c_str() + colon ||
+            !(isRxQueueIrq(irqName, interfaceName) || (!deviceName.empty() && isRxQueueIrq(irqName, deviceName)))) {
+            continue;
+        }
+
+        snprintf(path, sizeof path, "/proc/irq/%ld/smp_affinity_list", irq);
+        string affinity;
+        if (readFile(path, 4096, &affinity) != 0 || affinity.empty()) {
+            continue;
+        }
+        // "0-3", "2" 或者 "0,4"，取第一个CPU
+        cpus.push_back(atoi(affinity.c_str()));
+    }
+    return cpus;
+}
+
+bool EventLoopThreadPool::setCpuAffinityFromNic(const string& interfaceName)
+{
+    std::vector<int> cpus = nicQueueCpus(interfaceName);
+    if (cpus.empty()) {
+        LOG_WARN << "EventLoopThreadPool::setCpuAffinityFromNic - no rx queue irq found for " << interfaceName;
+        return false;
+    }
+
+    std::vector<std::vector<int>> cpuSets;
+    for (int cpu: cpus) {
+        cpuSets.push_back(std::vector<int>(1, cpu));
+    }
+    setCpuAffinity(cpuSets);
+    return true;
+}
+
 void EventLoopThreadPool::start(const ThreadInitCallback& cb)
 {
     assert(!started_);
@@ -27,7 +152,10 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb)
     for (int i = 0; i < numThreads_; ++i) {
         char buf[name_.size() + 32];
         snprintf(buf, sizeof(buf), "%s%d", name_.c_str(), i);
-        EventLoopThread* t = new EventLoopThread(cb, buf);
+        EventLoopThread* t = new EventLoopThread(cb, buf, timerBackend_);
+        if (!cpuSets_.empty()) {
+            t->setCpuAffinity(cpuSets_[i % cpuSets_.size()]);
+        }
         threads_.push_back(std::unique_ptr<EventLoopThread>(t));
         loops_.push_back(t->startLoop());
     }
@@ -77,4 +205,65 @@ std::vector<EventLoop*> EventLoopThreadPool::getAllLoops()
     } else {
         return loops_;
     }
-}
\ No newline at end of file
+}
+
+EventLoop* EventLoopThreadPool::getLoopForConnection(const InetAddress& peerAddr)
+{
+    baseLoop_->assertInLoopThread();
+    assert(started_);
+
+    if (loops_.empty()) {
+        return baseLoop_;
+    }
+
+    if (dispatchCallback_) {
+        EventLoop* loop = dispatchCallback_(loops_, peerAddr);
+        assert(loop != NULL);
+        return loop;
+    }
+
+    const size_t n = loops_.size();
+    switch (dispatchPolicy_) {
+        case kLeastConnections:
+        case kLeastPendingFunctors: {
+            // 从轮转的位置开始扫描，负载相同时仍然轮流分配
+            size_t best = next_;
+            for (size_t k = 1; k < n; ++k) {
+                size_t i = (next_ + k) % n;
+                bool better = dispatchPolicy_ == kLeastConnections ?
+                    loops_[i]->numConnections() < loops_[best]->numConnections() :
+                    loops_[i]->queueSize() < loops_[best]->queueSize();
+                if (better) {
+                    best = i;
+                }
+            }
+            next_ = static_cast<int>((next_ + 1) % n);
+            return loops_[best];
+        }
+
+        case kPowerOfTwoChoices: {
+            if (n == 1) {
+                return loops_[0];
+            }
+            // xorshift64*，只在baseLoop_的线程中使用
+            randomState_ ^= randomState_ >> 12;
+            randomState_ ^= randomState_ << 25;
+            randomState_ ^= randomState_ >> 27;
+            uint64_t r = randomState_ * 2685821657736338717ULL;
+            size_t a = static_cast<size_t>(r % n);
+            size_t b = static_cast<size_t>((a + 1 + (r >> 32) % (n - 1)) % n);
+            int busyA = loops_[a]->busyPermille();
+            int busyB = loops_[b]->busyPermille();
+            if (busyA != busyB) {
+                return busyA < busyB ? loops_[a] : loops_[b];
+            }
+            return loops_[a]->numConnections() <= loops_[b]->numConnections() ? loops_[a] : loops_[b];
+        }
+
+        case kPeerAddressHash:
+            return loops_[jumpConsistentHash(hashPeerIp(peerAddr), static_cast<int>(n))];
+
+        default:
+            return getNextLoop();
+    }
+}
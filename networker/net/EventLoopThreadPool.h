@@ -3,8 +3,11 @@
 
 #include "networker/base/Types.h"
 #include "networker/base/noncopyable.h"
+#include "networker/net/TimerId.h"
 
+#include <assert.h>
 #include <functional>
+#include <stdint.h>
 #include <memory>
 #include <vector>
 
@@ -14,17 +17,41 @@ namespace net
 {
     class EventLoop;
     class EventLoopThread;
+    class InetAddress;
 
     class EventLoopThreadPool: noncopyable
     {
+        public:
+            // getLoopForConnection选择IO线程的策略
+            enum DispatchPolicy
+            {
+                kRoundRobin,            // 轮流分配，与getNextLoop相同
+                kLeastConnections,      // 现有连接最少的IO线程，EventLoop::numConnections
+                kLeastPendingFunctors,  // 待执行functor最少的IO线程，EventLoop::queueSize
+                /**
+                 * 随机取两个IO线程，选择最近忙碌时间占比(EventLoop::busyPermille)较低的那个，相同时选连接少的
+                 * 不需要扫描所有IO线程，也不会像"选最空闲的"那样让一批新连接同时涌向同一个IO线程
+                 */
+                kPowerOfTwoChoices,
+                // 按对端IP做一致性哈希，同一个客户端主机的连接总在同一个IO线程中，IO线程数变化时只有少量客户端被重新分配
+                kPeerAddressHash,
+            };
+
+            typedef std::function<EventLoop* (const std::vector<EventLoop*>& loops, const InetAddress& peerAddr)> DispatchCallback;
+
         private:
             EventLoop *baseLoop_;
             string name_;
             bool started_;
             int numThreads_;
             int next_;
+            TimerBackend timerBackend_;
+            std::vector<std::vector<int>> cpuSets_;
             std::vector<std::unique_ptr<EventLoopThread>> threads_;
             std::vector<EventLoop*> loops_;
+            DispatchPolicy dispatchPolicy_;
+            DispatchCallback dispatchCallback_;
+            uint64_t randomState_;
         
         public:
             typedef std::function<void(EventLoop*)> ThreadInitCallback;
@@ -38,6 +65,32 @@ namespace net
                 numThreads_ = numThreads;
             }
 
+            // 设置IO线程中EventLoop的定时器实现，必须在start之前调用
+            void setTimerBackend(TimerBackend timerBackend)
+            {
+                timerBackend_ = timerBackend;
+            }
+
+            /**
+             * 第i个IO线程绑定到cpuSets[i % cpuSets.size()]中的CPU上，为空时不绑定，必须在start之前调用
+             * 与TcpServer::setReusePortCpuAffinity一起使用时，第i个IO线程应当绑定到 cpu % numThreads == i 的CPU上，
+             * 这样新连接在处理其网卡中断的CPU上被接受，之后也一直在这个CPU上处理
+             */
+            void setCpuAffinity(const std::vector<std::vector<int>>& cpuSets)
+            {
+                assert(!started_);
+                cpuSets_ = cpuSets;
+            }
+
+            /**
+             * 按网卡interfaceName各个接收队列的中断亲和性绑定IO线程: 第i个IO线程绑定到第i个队列的中断所在的CPU上
+             * 找不到该网卡的队列中断时返回false，不改变之前的设置
+             */
+            bool setCpuAffinityFromNic(const string& interfaceName);
+
+            // 网卡interfaceName各个接收队列(按中断号的顺序)的中断所在的第一个CPU，读取/proc/interrupts和/proc/irq/N/smp_affinity_list
+            static std::vector<int> nicQueueCpus(const string& interfaceName);
+
             void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
             // 调用start才生效
@@ -47,6 +100,25 @@ namespace net
             // 使用相同的哈希代码，它将始终返回相同的EventLoop
             EventLoop *getLoopForHash(size_t hashCode);
 
+            void setDispatchPolicy(DispatchPolicy policy)
+            {
+                dispatchPolicy_ = policy;
+            }
+
+            DispatchPolicy dispatchPolicy() const
+            {
+                return dispatchPolicy_;
+            }
+
+            // 自定义的分配策略，设置后优先于DispatchPolicy，传入空的回调恢复使用DispatchPolicy
+            void setDispatchCallback(const DispatchCallback& cb)
+            {
+                dispatchCallback_ = cb;
+            }
+
+            // 调用start才生效，为来自peerAddr的新连接按分配策略选择一个IO线程
+            EventLoop *getLoopForConnection(const InetAddress& peerAddr);
+
             std::vector<EventLoop*> getAllLoops();
 
             bool started() const
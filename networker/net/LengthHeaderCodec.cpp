@@ -0,0 +1,195 @@
+#include "networker/net/LengthHeaderCodec.h"
+#include "networker/base/Logging.h"
+#include "networker/net/Buffer.h"
+#include "networker/net/Endian.h"
+#include "networker/net/TcpConnection.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+#include <algorithm>
+
+using namespace networker;
+using namespace networker::net;
+
+namespace
+{
+    // CRC-32 (IEEE 802.3，与zlib相同)的查表实现
+    struct Crc32Table
+    {
+        uint32_t table[256];
+
+        Crc32Table()
+        {
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; ++k) {
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                }
+                table[i] = c;
+            }
+        }
+    };
+
+    const Crc32Table kCrc32Table;
+
+    /**
+     * 帧长度来自对端，不可信，只按它预留这么多，剩下的随数据到达由Buffer扩容
+     * 否则几个字节的帧头就能让每个连接占用maxFrameSize的内存
+     */
+    const size_t kMaxReserve = 64 * 1024;
+
+    void defaultErrorCallback(const TcpConnectionPtr& conn, Buffer* buf, Timestamp, LengthHeaderCodec::ErrorCode error)
+    {
+        LOG_ERROR << "LengthHeaderCodec [" << conn->name() << "] - "
+                  << (error == LengthHeaderCodec::kFrameTooLarge ? "frame too large" : "checksum error");
+        // 丢弃剩余的数据，否则之后每次收到数据都会再次报错
+        buf->retrieveAll();
+        conn->shutdown();
+    }
+
+    // 长度头能表示的最大payload长度，headerLen不合法时返回0
+    size_t maxLengthOfHeader(int headerLen)
+    {
+        switch (headerLen) {
+            case 1:
+                return UINT8_MAX;
+
+            case 2:
+                return UINT16_MAX;
+
+            case 4:
+                return UINT32_MAX;
+
+            default:
+                return 0;
+        }
+    }
+};
+
+const size_t LengthHeaderCodec::kChecksumLen;
+const size_t LengthHeaderCodec::kDefaultMaxFrameSize;
+
+LengthHeaderCodec::LengthHeaderCodec(const FrameCallback& cb, int headerLen, size_t maxFrameSize, bool checksum)
+    : frameCallback_(cb), errorCallback_(defaultErrorCallback), headerLen_(headerLen),
+    maxFrameSize_(std::min(maxFrameSize, maxLengthOfHeader(headerLen))), checksum_(checksum)
+{
+    if (maxLengthOfHeader(headerLen) == 0) {
+        LOG_FATAL << "LengthHeaderCodec - invalid headerLen " << headerLen;
+    }
+    if (maxFrameSize > INT_MAX) {
+        LOG_FATAL << "LengthHeaderCodec - maxFrameSize " << maxFrameSize << " exceeds INT_MAX";
+    }
+    assert(frameOverhead() <= Buffer::kCheapPrepend);
+}
+
+uint32_t LengthHeaderCodec::crc32(const void* data, size_t len)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; ++i) {
+        c = kCrc32Table.table[(c ^ p[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+size_t LengthHeaderCodec::peekLength(const Buffer* buf) const
+{
+    switch (headerLen_) {
+        case 1:
+            return static_cast<uint8_t>(buf->peekInt8());
+
+        case 2:
+            return static_cast<uint16_t>(buf->peekInt16());
+
+        default:    // 构造函数保证只能是4
+            return static_cast<uint32_t>(buf->peekInt32());
+    }
+}
+
+/**
+ * 一次回调中可能有多个完整的帧，也可能只有半个
+ * 知道了帧的长度但数据还不够时，预留出帧剩余部分的空间(最多kMaxReserve)，减少大帧到来时Buffer的扩容次数
+ */
+void LengthHeaderCodec::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    const size_t overhead = frameOverhead();
+
+    while (buf->readableBytes() >= static_cast<size_t>(headerLen_)) {
+        const size_t len = peekLength(buf);
+        if (len > maxFrameSize_) {
+            errorCallback_(conn, buf, receiveTime, kFrameTooLarge);
+            break;
+        }
+
+        const size_t frameLen = overhead + len;
+        if (buf->readableBytes() < frameLen) {
+            buf->ensureWritableBytes(std::min(frameLen - buf->readableBytes(), kMaxReserve));
+            break;
+        }
+
+        const char* payload = buf->peek() + overhead;
+        if (checksum_) {
+            uint32_t be32 = 0;
+            ::memcpy(&be32, buf->peek() + headerLen_, sizeof(be32));
+            if (networkToHost32(be32) != crc32(payload, len)) {
+                errorCallback_(conn, buf, receiveTime, kChecksumError);
+                break;
+            }
+        }
+
+        frameCallback_(conn, StringPiece(payload, static_cast<int>(len)), receiveTime);
+        buf->retrieve(frameLen);
+    }
+}
+
+/**
+ * maxFrameSize_不超过长度头能表示的最大值，检查了它就不会写出被截断的长度
+ */
+bool LengthHeaderCodec::encode(Buffer* buf) const
+{
+    const size_t len = buf->readableBytes();
+    if (len > maxFrameSize_) {
+        LOG_ERROR << "LengthHeaderCodec::encode - payload of " << len << " bytes exceeds maxFrameSize " << maxFrameSize_;
+        return false;
+    }
+
+    if (checksum_) {
+        buf->prependInt32(static_cast<int32_t>(crc32(buf->peek(), len)));
+    }
+
+    switch (headerLen_) {
+        case 1:
+            buf->prependInt8(static_cast<int8_t>(len));
+            break;
+
+        case 2:
+            buf->prependInt16(static_cast<int16_t>(len));
+            break;
+
+        default:
+            buf->prependInt32(static_cast<int32_t>(len));
+            break;
+    }
+    return true;
+}
+
+bool LengthHeaderCodec::send(const TcpConnectionPtr& conn, const StringPiece& message) const
+{
+    Buffer buf;
+    buf.append(message);
+    if (!encode(&buf)) {
+        return false;
+    }
+    conn->send(&buf);
+    return true;
+}
+
+bool LengthHeaderCodec::send(const TcpConnectionPtr& conn, Buffer* message) const
+{
+    if (!encode(message)) {
+        return false;
+    }
+    conn->send(message);
+    return true;
+}
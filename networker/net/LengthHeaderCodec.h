@@ -0,0 +1,113 @@
+#ifndef NETWORKER_NET_LENGTHHEADERCODEC_H
+#define NETWORKER_NET_LENGTHHEADERCODEC_H
+
+#include "networker/base/noncopyable.h"
+#include "networker/base/StringPiece.h"
+#include "networker/base/Timestamp.h"
+#include "networker/net/Callbacks.h"
+
+#include <stdint.h>
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * 长度头分帧的编解码器，放在TcpConnection和用户的消息回调之间
+     *
+     * 帧格式(整数都是大端):
+     *  +-----------------+--------------------+-----------+
+     *  | length(1/2/4字节) | checksum(4字节,可选) |  payload  |
+     *  +-----------------+--------------------+-----------+
+     *  length是payload的字节数，checksum是payload的CRC32
+     *
+     * 解码: onMessage作为TcpServer/TcpClient的MessageCallback，每个完整的帧以StringPiece的形式
+     *      直接指向输入Buffer中的payload回调用户，不拷贝。这个StringPiece只在回调期间有效
+     * 编码: payload已经在Buffer中时，checksum和length用Buffer::prepend写进前面预留的kCheapPrepend字节，不移动payload
+     *
+     * 编解码器本身没有可变状态，一个实例可以同时用于多个IO线程中的多个连接
+     */
+    class LengthHeaderCodec: noncopyable
+    {
+        public:
+            enum ErrorCode
+            {
+                kFrameTooLarge,     // length超过了maxFrameSize
+                kChecksumError,     // checksum不匹配
+            };
+
+            typedef std::function<void (const TcpConnectionPtr&, const StringPiece& payload, Timestamp)> FrameCallback;
+
+            typedef std::function<void (const TcpConnectionPtr&, Buffer*, Timestamp, ErrorCode)> ErrorCallback;
+
+            static const size_t kChecksumLen = sizeof(uint32_t);
+
+            static const size_t kDefaultMaxFrameSize = 64 * 1024 * 1024;
+
+        private:
+            FrameCallback frameCallback_;
+            ErrorCallback errorCallback_;
+            const int headerLen_;
+            const size_t maxFrameSize_;
+            const bool checksum_;
+
+        public:
+            /**
+             * headerLen: 长度头的字节数，1, 2 或 4，其他值是LOG_FATAL
+             * maxFrameSize: payload的最大长度，超过时回调ErrorCallback(默认记录日志，丢弃缓冲区中的数据并关闭连接)
+             *               不能超过INT_MAX(payload以StringPiece回调)，否则LOG_FATAL；大于长度头能表示的最大值时按后者
+             * checksum: 是否在长度头之后带payload的CRC32
+             */
+            explicit LengthHeaderCodec(const FrameCallback& cb, int headerLen = 4,
+                size_t maxFrameSize = kDefaultMaxFrameSize, bool checksum = false);
+
+            void setErrorCallback(const ErrorCallback& cb)
+            {
+                errorCallback_ = cb;
+            }
+
+            int headerLen() const
+            {
+                return headerLen_;
+            }
+
+            size_t maxFrameSize() const
+            {
+                return maxFrameSize_;
+            }
+
+            bool hasChecksum() const
+            {
+                return checksum_;
+            }
+
+            // 长度头和checksum的字节数
+            size_t frameOverhead() const
+            {
+                return headerLen_ + (checksum_ ? kChecksumLen : 0);
+            }
+
+            // 绑定到TcpServer/TcpClient的setMessageCallback
+            void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+            /**
+             * 把buf中的全部数据作为payload，就地在前面加上checksum和长度头
+             * payload超过maxFrameSize时记录日志并返回false，buf不变
+             */
+            bool encode(Buffer* buf) const;
+
+            // 拷贝message到一个新的Buffer中编码后发送，message太长时不发送，返回false
+            bool send(const TcpConnectionPtr& conn, const StringPiece& message) const;
+
+            // 就地编码message后发送，message被清空，不拷贝payload；message太长时不发送，返回false，message不变
+            bool send(const TcpConnectionPtr& conn, Buffer* message) const;
+
+            static uint32_t crc32(const void* data, size_t len);
+
+        private:
+            size_t peekLength(const Buffer* buf) const;
+    };
+};
+};
+
+#endif
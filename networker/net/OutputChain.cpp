@@ -0,0 +1,184 @@
+#include "networker/net/OutputChain.h"
+#include "networker/net/SocketsOps.h"
+#include "networker/base/Logging.h"
+
+#include <errno.h>
+#include <sys/uio.h>
+
+using namespace networker;
+using namespace networker::net;
+
+const int OutputChain::kMaxIovecs;
+const size_t OutputChain::kCopyThreshold;
+
+void OutputChain::Segment::retrieve(size_t len)
+{
+    assert(len <= readableBytes());
+    if (buffer_) {
+        buffer_->retrieve(len);
+    } else {
+        if (isFile()) {
+            fileOffset_ += len;
+        } else {
+            data_ += len;
+        }
+        len_ -= len;
+    }
+}
+
+void OutputChain::append(const char* data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+
+    if (segments_.empty() || segments_.back().buffer_ == NULL || tailSealed_) {
+        std::shared_ptr<Buffer> buf(new Buffer(std::max(len, Buffer::kInitialSize)));
+        Segment seg = {buf, buf.get(), NULL, 0, -1, 0};
+        segments_.push_back(std::move(seg));
+        tailSealed_ = false;
+    }
+
+    segments_.back().buffer_->append(data, len);
+    readableBytes_ += len;
+}
+
+void OutputChain::append(std::shared_ptr<const void> holder, const char* data, size_t len)
+{
+    if (len < kCopyThreshold) {
+        append(data, len);
+        return;
+    }
+
+    Segment seg = {std::move(holder), NULL, data, len, -1, 0};
+    segments_.push_back(std::move(seg));
+    readableBytes_ += len;
+}
+
+void OutputChain::append(string&& str)
+{
+    if (str.size() < kCopyThreshold) {
+        append(str.data(), str.size());
+        return;
+    }
+
+    std::shared_ptr<const string> holder(std::make_shared<const string>(std::move(str)));
+    append(holder, holder->data(), holder->size());
+}
+
+void OutputChain::append(Buffer* buf)
+{
+    size_t len = buf->readableBytes();
+    if (len < kCopyThreshold) {
+        append(buf->peek(), len);
+        buf->retrieveAll();
+        return;
+    }
+
+    // 接管buf的存储，之后的小块数据可以继续合并到这个Buffer中
+    std::shared_ptr<Buffer> owned(new Buffer);
+    owned->swap(*buf);
+    Segment seg = {owned, owned.get(), NULL, 0, -1, 0};
+    segments_.push_back(std::move(seg));
+    readableBytes_ += len;
+    tailSealed_ = false;
+}
+
+void OutputChain::appendFile(std::shared_ptr<const void> holder, int fd, off_t offset, size_t len)
+{
+    assert(fd >= 0);
+    if (len == 0) {
+        return;
+    }
+
+    Segment seg = {std::move(holder), NULL, NULL, len, fd, offset};
+    segments_.push_back(std::move(seg));
+    readableBytes_ += len;
+}
+
+void OutputChain::retrieve(size_t len)
+{
+    assert(len <= readableBytes_);
+    readableBytes_ -= len;
+
+    while (len > 0) {
+        assert(!segments_.empty());
+        Segment& seg = segments_.front();
+        size_t readable = seg.readableBytes();
+
+        if (len < readable) {
+            seg.retrieve(len);
+            break;
+        }
+
+        len -= readable;
+        segments_.pop_front();
+    }
+}
+
+void OutputChain::retrieveAll()
+{
+    segments_.clear();
+    readableBytes_ = 0;
+    tailSealed_ = false;
+}
+
+int OutputChain::peekIovec(struct iovec* iov, int maxIovecs) const
+{
+    int n = 0;
+    for (SegmentList::const_iterator it = segments_.begin(); it != segments_.end() && n < maxIovecs; ++it) {
+        if (it->isFile()) {
+            break;
+        }
+
+        size_t readable = it->readableBytes();
+        if (readable == 0) {
+            continue;
+        }
+        iov[n].iov_base = const_cast<char*>(it->peek());
+        iov[n].iov_len = readable;
+        ++n;
+    }
+    return n;
+}
+
+/**
+ * 与Buffer::readFd()对应，只调用一次writev(2)或sendfile(2)
+ * 没写完的数据留在链中，等下一次可写事件
+ */
+ssize_t OutputChain::writeFd(int fd, int* savedErrno)
+{
+    if (!segments_.empty() && segments_.front().isFile()) {
+        Segment& seg = segments_.front();
+        off_t offset = seg.fileOffset_;
+        ssize_t n = sockets::sendfile(fd, seg.fileFd_, &offset, seg.len_);
+
+        if (n > 0) {
+            retrieve(n);
+            return n;
+        }
+
+        *savedErrno = n < 0 ? errno : EIO;
+        if (*savedErrno == EWOULDBLOCK) {
+            return -1;
+        }
+
+        // 文件比声明的长度短(按EIO处理)或者sendfile出错，剩余部分已经无法发送了
+        LOG_ERROR << "OutputChain::writeFd - file fd = " << seg.fileFd_ << " fails at offset " << seg.fileOffset_
+                  << ", drop " << seg.len_ << " bytes";
+        readableBytes_ -= seg.len_;
+        segments_.pop_front();
+        return -1;
+    }
+
+    struct iovec vec[kMaxIovecs];
+    int iovcnt = peekIovec(vec, kMaxIovecs);
+
+    ssize_t n = sockets::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        *savedErrno = errno;
+    } else {
+        retrieve(n);
+    }
+    return n;
+}
@@ -0,0 +1,144 @@
+#ifndef NETWORKER_NET_OUTPUTCHAIN_H
+#define NETWORKER_NET_OUTPUTCHAIN_H
+
+#include "networker/base/StringPiece.h"
+#include "networker/base/Types.h"
+#include "networker/net/Buffer.h"
+
+#include <deque>
+#include <memory>
+
+struct iovec;
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * TcpConnection 的输出链，由若干个引用计数的分段(segment)组成
+     *
+     * 分段有三种:
+     *  1. 拷贝分段: 由输出链自己持有的Buffer，小块数据会被追加(合并)到链尾的拷贝分段中
+     *  2. 引用分段: 通过shared_ptr持有外部数据(string, Buffer, 任意blob)，数据本身不发生拷贝
+     *      广播时同一个shared_ptr<const string>可以被多个连接的输出链同时引用
+     *  3. 文件分段: 文件fd的一段区间，由sendfile(2)在内核中直接发送，不经过用户空间
+     *
+     * handleWrite 时通过一次writev(2)把链头部的多个内存分段一起写出
+     * 链头部是文件分段时改用一次sendfile(2)，这样内存数据和文件数据按加入的顺序交错发送
+     *
+     * 输出链只能在连接所属的IO线程中使用，因此不必加锁
+     */
+    class OutputChain
+    {
+        private:
+            struct Segment
+            {
+                std::shared_ptr<const void> holder_;    // 保证数据在写出之前一直有效
+                Buffer* buffer_;                        // 拷贝分段时指向holder_持有的Buffer，否则为NULL
+                const char* data_;                      // 引用分段的剩余数据
+                size_t len_;                            // 引用分段或文件分段的剩余长度
+                int fileFd_;                            // 文件分段的fd，内存分段为-1
+                off_t fileOffset_;                      // 文件分段下一次发送的偏移
+
+                bool isFile() const
+                {
+                    return fileFd_ >= 0;
+                }
+
+                const char* peek() const
+                {
+                    return buffer_ ? buffer_->peek() : data_;
+                }
+
+                size_t readableBytes() const
+                {
+                    return buffer_ ? buffer_->readableBytes() : len_;
+                }
+
+                void retrieve(size_t len);
+            };
+
+            typedef std::deque<Segment> SegmentList;
+
+            SegmentList segments_;
+
+            size_t readableBytes_;
+
+            bool tailSealed_;   // 链尾的拷贝分段正在被异步发送引用，不能再合并数据
+
+        public:
+            // writev一次最多提交的分段数，不超过IOV_MAX
+            static const int kMaxIovecs = 64;
+
+            // 小于该长度的引用数据直接拷贝到拷贝分段中，避免链中出现大量碎片
+            static const size_t kCopyThreshold = 256;
+
+            OutputChain(): readableBytes_(0), tailSealed_(false)
+            {
+            }
+
+            size_t readableBytes() const
+            {
+                return readableBytes_;
+            }
+
+            bool empty() const
+            {
+                return readableBytes_ == 0;
+            }
+
+            size_t numSegments() const
+            {
+                return segments_.size();
+            }
+
+            // 拷贝数据，优先合并到链尾的拷贝分段
+            void append(const char* data, size_t len);
+
+            void append(const StringPiece& str)
+            {
+                append(str.data(), str.size());
+            }
+
+            // 引用 holder 持有的 [data, data + len)，不发生拷贝
+            void append(std::shared_ptr<const void> holder, const char* data, size_t len);
+
+            void append(const std::shared_ptr<const string>& str)
+            {
+                append(str, str->data(), str->size());
+            }
+
+            void append(string&& str);
+
+            // 交换buf中的数据，buf被清空，不发生拷贝
+            void append(Buffer* buf);
+
+            // 引用文件fd中 [offset, offset + len) 的数据，holder负责保证fd在发送完之前一直有效
+            void appendFile(std::shared_ptr<const void> holder, int fd, off_t offset, size_t len);
+
+            void retrieve(size_t len);
+
+            void retrieveAll();
+
+            // 把链头部的内存分段填入iov(遇到文件分段为止), 返回填入的个数
+            int peekIovec(struct iovec* iov, int maxIovecs) const;
+
+            /**
+             * peekIovec的结果交给异步发送(io_uring)之后调用，在发送完成之前数据的地址必须保持不变
+             * 之后追加的数据放进新的拷贝分段，不再合并到现有的Buffer中(合并可能移动或重新分配其中的数据)
+             */
+            void sealTail()
+            {
+                tailSealed_ = true;
+            }
+
+            /**
+             * 一次writev或sendfile写出尽量多的数据，并移除已写出的部分
+             * 文件分段出错或者文件提前结束(*savedErrno为EIO)时丢弃这个分段并返回-1，之后的数据不能再按顺序发送
+             */
+            ssize_t writeFd(int fd, int* savedErrno);
+    };
+};
+};
+
+#endif
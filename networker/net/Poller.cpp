@@ -1,10 +1,18 @@
 #include "networker/net/Poller.h"
 #include "networker/net/Channel.h"
 
+#include <algorithm>
+#include <assert.h>
+
 using namespace networker;
 using namespace networker::net;
 
-Poller::Poller(EventLoop *loop): ownerLoop_(loop)
+namespace
+{
+    const size_t kInitChannelTableSize = 64;
+};
+
+Poller::Poller(EventLoop *loop): channels_(kInitChannelTableSize), numChannels_(0), ownerLoop_(loop)
 {
 }
 
@@ -13,6 +21,27 @@ Poller::~Poller() = default;
 bool Poller::hasChannel(Channel* channel) const
 {
     assertInLoopThread();
-    ChannelMap::const_iterator it = channels_.find(channel->fd());
-    return it != channels_.end() && it->second == channel;
+    return findChannel(channel->fd()) == channel;
+}
+
+void Poller::insertChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    assert(fd >= 0);
+    assert(findChannel(fd) == NULL);
+
+    if (static_cast<size_t>(fd) >= channels_.size()) {
+        // 按2倍扩容，均摊O(1)
+        channels_.resize(std::max(static_cast<size_t>(fd) + 1, channels_.size() * 2));
+    }
+    channels_[fd] = channel;
+    ++numChannels_;
+}
+
+void Poller::eraseChannel(Channel *channel)
+{
+    int fd = channel->fd();
+    assert(findChannel(fd) == channel);
+    channels_[fd] = NULL;
+    --numChannels_;
 }
\ No newline at end of file
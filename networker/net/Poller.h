@@ -1,16 +1,21 @@
 #ifndef NETWORKER_NET_POLLER_H
 #define NETWORKER_NET_POLLER_H
 
-#include <map>
+#include <errno.h>
+#include <sys/types.h>
+#include <memory>
 #include <vector>
 
 #include "networker/base/Timestamp.h"
 #include "networker/net/EventLoop.h"
 
+struct iovec;
+
 namespace networker
 {
 namespace net
 {
+    class Buffer;
     class Channel;
 
     // IO multiplexing 的封装
@@ -20,8 +25,14 @@ namespace net
             typedef std::vector<Channel*> ChannelList;
         
         protected:
-            typedef std::map<int, Channel*> ChannelMap;
-            ChannelMap channels_;
+            /**
+             * 以fd为下标的Channel表，按需扩容
+             * fd是从小到大分配的小整数，数组比std::map少了树的查找和每个结点的内存分配
+             */
+            typedef std::vector<Channel*> ChannelTable;
+            ChannelTable channels_;
+
+            size_t numChannels_;    // channels_中非空的个数
         
         private:
             EventLoop *ownerLoop_;
@@ -51,12 +62,74 @@ namespace net
 
             virtual bool hasChannel(Channel *channel) const;
 
+            // 是否支持Channel::setEdgeTriggered，不支持的后端按水平触发处理
+            virtual bool supportsEdgeTriggered() const
+            {
+                return false;
+            }
+
+            /**
+             * 是否支持完成模式的IO(Channel::setCompletionMode)
+             * 完成模式的Channel由Poller代为recv/accept/send，处理事件时用下面的take*取结果
+             */
+            virtual bool supportsCompletionIo() const
+            {
+                return false;
+            }
+
+            /**
+             * 取出完成模式的Channel收到的数据，追加到buf
+             * 返回追加的字节数，对端关闭返回0，出错返回-1并设置*savedErrno，没有数据时返回-1，*savedErrno为EWOULDBLOCK
+             */
+            virtual ssize_t takeReceived(Channel *channel, Buffer *buf, int *savedErrno)
+            {
+                *savedErrno = EWOULDBLOCK;
+                return -1;
+            }
+
+            // 取出一个接受的连接，返回值和*savedErrno的含义同accept(2)，没有连接时为EWOULDBLOCK
+            virtual int takeAccepted(Channel *channel, int *savedErrno)
+            {
+                *savedErrno = EWOULDBLOCK;
+                return -1;
+            }
+
+            /**
+             * 提交一次发送，iov指向的数据在完成之前必须保持不变，holder保证它们(和fd)一直有效
+             * 同一个Channel同时只能有一个发送，完成后Channel收到POLLOUT，由takeSendResult取结果
+             */
+            virtual void submitSend(Channel *channel, const struct iovec *iov, int iovcnt, std::shared_ptr<const void> holder)
+            {
+            }
+
+            // 取出发送的结果: 写出的字节数或者-errno，没有完成的发送时返回false
+            virtual bool takeSendResult(Channel *channel, ssize_t *result)
+            {
+                return false;
+            }
+
+            size_t numChannels() const
+            {
+                return numChannels_;
+            }
+
             static Poller* newDefaultPoller(EventLoop* loop);
 
             void assertInLoopThread() const
             {
                 ownerLoop_->assertInLoopThread();
             }
+
+        protected:
+            // fd上没有Channel时返回NULL
+            Channel* findChannel(int fd) const
+            {
+                return (fd >= 0 && static_cast<size_t>(fd) < channels_.size()) ? channels_[fd] : NULL;
+            }
+
+            void insertChannel(Channel *channel);
+
+            void eraseChannel(Channel *channel);
     };
 };
 };
@@ -3,6 +3,8 @@
     #include "networker/net/SocketsOps.h"
     #include "networker/base/Logging.h"
 
+    #include <assert.h>
+    #include <linux/filter.h>
     #include <netinet/in.h>
     #include <netinet/tcp.h>
     #include <stdio.h>  // snprintf
@@ -125,6 +127,38 @@
     #endif
     }
 
+    /**
+     * 内核在处理SYN的CPU上执行这个程序，返回值就是组内socket的下标
+     *  A = 当前CPU编号
+     *  A = A % numSockets
+     *  return A
+     * 如果IO线程i绑定在CPU i上，连接就由收到SYN的那个CPU上的线程接受，不会跨CPU
+     */
+    bool Socket::attachReusePortCpuFilter(int numSockets)
+    {
+    #ifdef SO_ATTACH_REUSEPORT_CBPF
+        assert(numSockets > 0);
+        struct sock_filter code[] = {
+            { BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU) },
+            { BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<uint32_t>(numSockets) },
+            { BPF_RET | BPF_A, 0, 0, 0 },
+        };
+        struct sock_fprog prog;
+        prog.len = static_cast<unsigned short>(sizeof(code) / sizeof(code[0]));
+        prog.filter = code;
+
+        if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, static_cast<socklen_t>(sizeof(prog))) < 0) {
+            LOG_SYSERR << "SO_ATTACH_REUSEPORT_CBPF failed.";
+            return false;
+        }
+        return true;
+    #else
+        (void)numSockets;
+        LOG_ERROR << "SO_ATTACH_REUSEPORT_CBPF is not supported.";
+        return false;
+    #endif
+    }
+
     // SO_KEEPALIVE 发送周期性保活报文以维持连接
     void Socket::setKeepAlive(bool on)
     {
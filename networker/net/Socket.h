@@ -61,6 +61,12 @@ namespace net
             // SO_REUSEPORT 支持多个进程或线程绑定同一个端口，提高服务器性能
             void setReusePort(bool on);
 
+            /**
+             * 给该socket所在的SO_REUSEPORT组挂上一个cBPF程序: 在第 cpu % numSockets 个socket上接受新连接
+             * 组内socket的顺序就是调用listen的顺序，返回true表示成功
+             */
+            bool attachReusePortCpuFilter(int numSockets);
+
             // 启动/禁用 SO_KEEPALIVE
             // SO_KEEPALIVE 发送周期性保活报文以维持连接
             void setKeepAlive(bool on);
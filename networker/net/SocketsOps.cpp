@@ -7,7 +7,8 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stdio.h>      // snprintf
-#include <sys/uio.h>    // readv
+#include <sys/sendfile.h>
+#include <sys/uio.h>    // readv, writev
 #include <unistd.h>
 #include <assert.h>
 
@@ -16,6 +17,7 @@ using namespace networker::net;
 
 namespace
 {
+#if defined (NO_ACCEPT4)
     void setNonBlockAndCloseOnExec(int sockfd)
     {
         // non-block
@@ -30,6 +32,7 @@ namespace
 
         (void) ret;
     }
+#endif
 };
 
 
@@ -109,20 +112,28 @@ void sockets::listenOrDie(int sockfd)
 int sockets::accept(int sockfd, struct sockaddr_in6* addr)
 {
     socklen_t addrlen = static_cast<socklen_t>(sizeof(*addr));
+#if defined (NO_ACCEPT4)
     int connfd = ::accept(sockfd, sockaddr_cast(addr), &addrlen);
-    setNonBlockAndCloseOnExec(connfd);
+    if (connfd >= 0) {
+        setNonBlockAndCloseOnExec(connfd);
+    }
+#else
+    // 一次系统调用完成accept和设置非阻塞，close-on-exec
+    int connfd = ::accept4(sockfd, sockaddr_cast(addr), &addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#endif
 
     if (connfd < 0) {
         int savedErrno = errno;
-        LOG_SYSERR << "Socket::accept";
         switch (savedErrno) {
             case EAGAIN:
+                // 监听队列已经取空，批量accept的正常结束条件，不记录日志
+                break;
             case ECONNABORTED:
             case EINTR:
             case EPROTO:
             case EPERM:
             case EMFILE:
-                errno = savedErrno;
+                LOG_SYSERR << "Socket::accept";
                 break;
             case EBADF:
             case EFAULT:
@@ -138,6 +149,7 @@ int sockets::accept(int sockfd, struct sockaddr_in6* addr)
                 LOG_FATAL << "unknown error of ::accept " << savedErrno;
                 break;
         }
+        errno = savedErrno;
     }
     
     return connfd;
@@ -163,6 +175,20 @@ ssize_t sockets::write(int sockfd, const void *buf, size_t count)
   return ::write(sockfd, buf, count);
 }
 
+ssize_t sockets::writev(int sockfd, const struct iovec *iov, int iovcnt)
+{
+  return ::writev(sockfd, iov, iovcnt);
+}
+
+/**
+ * sendfile(2) 在内核中把文件数据直接拷贝到socket，不经过用户空间
+ * offset 会被更新为最后发送的字节之后的位置，文件本身的偏移不受影响
+ */
+ssize_t sockets::sendfile(int sockfd, int fileFd, off_t *offset, size_t count)
+{
+  return ::sendfile(sockfd, fileFd, offset, count);
+}
+
 void sockets::close(int sockfd)
 {
     /**
@@ -7,6 +7,32 @@
 #include "networker/net/SocketsOps.h"
 
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace
+{
+    // 边沿触发模式下每次可读事件最多调用readFd的次数
+    const int kMaxReadsPerEvent = 16;
+
+    // 持有sendFile时dup出来的fd，文件分段发送完(或连接销毁)时关闭
+    class FileHolder: networker::noncopyable
+    {
+        private:
+            const int fd_;
+
+        public:
+            explicit FileHolder(int fd): fd_(fd)
+            {
+            }
+
+            ~FileHolder()
+            {
+                ::close(fd_);
+            }
+    };
+};
 
 void networker::net::defaultConnectionCallback(const TcpConnectionPtr& conn)
 {
@@ -24,7 +50,7 @@ using namespace networker;
 using namespace networker::net;
 
 TcpConnection::TcpConnection(EventLoop *loop, const string& nameArg, int sockfd, const InetAddress& localAddr, const InetAddress& peerAddr)
-    :loop_(loop), name_(nameArg), state_(kConnecting), reading_(true), 
+    :loop_(loop), name_(nameArg), state_(kConnecting), reading_(true), edgeTriggered_(false), writeBatching_(false), flushScheduled_(false), completionIo_(false), sendInFlight_(false),
     socket_(new Socket(sockfd)), channel_(new Channel(loop, sockfd)), 
     localAddr_(localAddr), peerAddr_(peerAddr), highWaterMark_(64 * 1024 * 1024)
 {
@@ -37,6 +63,7 @@ TcpConnection::TcpConnection(EventLoop *loop, const string& nameArg, int sockfd,
     channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
 
     socket_->setKeepAlive(true);
+    loop_->connectionCreated();
 }
 
 TcpConnection::~TcpConnection()
@@ -62,42 +89,98 @@ void TcpConnection::send(const void *data, int len)
 }
 
 /**
- * 如果在非IO线程调用，它会把message复制一份，传给IO线程中的sendInLoop()来发送
- * 这样做或许有轻微的效率损失，但是线程安全性很容易验证
+ * 如果在非IO线程调用，它会把message复制一份(仅此一次)，传给IO线程中的sendStringInLoop()来发送
+ * 没写完的部分直接引用这份拷贝挂到输出链上，不会再拷贝第二次
  */
 void TcpConnection::send(const StringPiece& message)
 {
     if (state_ == kConnected) {
         if (loop_->isInLoopThread()) {
-            sendInLoop(message);
+            sendInLoop(message.data(), message.size());
         } else {
-            void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
             loop_->runInLoop(
-                std::bind(fp, this, message.as_string())
+                std::bind(&TcpConnection::sendStringInLoop, this, std::make_shared<const string>(message.as_string()))
             );
         }
     }
 }
 
-void TcpConnection::send(Buffer *buf)
+void TcpConnection::send(string&& message)
 {
     if (state_ == kConnected) {
+        std::shared_ptr<const string> str(std::make_shared<const string>(std::move(message)));
         if (loop_->isInLoopThread()) {
+            sendStringInLoop(str);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, str));
+        }
+    }
+}
+
+void TcpConnection::send(const std::shared_ptr<const string>& message)
+{
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendStringInLoop(message);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendStringInLoop, this, message));
+        }
+    }
+}
+
+void TcpConnection::send(Buffer *buf)
+{
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread() && buf->readableBytes() < OutputChain::kCopyThreshold) {
             sendInLoop(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
         } else {
-            void (TcpConnection::*fp)(const StringPiece& message) = &TcpConnection::sendInLoop;
-            loop_->runInLoop(std::bind(fp, this, buf->retrieveAllAsString()));
+            // 交换出buf的数据，之后无论在哪个线程发送都不再拷贝
+            std::shared_ptr<Buffer> owned(new Buffer);
+            owned->swap(*buf);
+            if (loop_->isInLoopThread()) {
+                sendBufferInLoop(owned);
+            } else {
+                loop_->runInLoop(std::bind(&TcpConnection::sendBufferInLoop, this, owned));
+            }
+        }
+    }
+}
+
+void TcpConnection::sendFile(int fd, off_t offset, size_t count)
+{
+    if (state_ == kConnected && count > 0) {
+        int dupfd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+        if (dupfd < 0) {
+            LOG_SYSERR << "TcpConnection::sendFile [" << name_ << "] dup fd = " << fd;
+            return;
+        }
+
+        std::shared_ptr<const void> holder(std::make_shared<FileHolder>(dupfd));
+        if (loop_->isInLoopThread()) {
+            sendFileInLoop(holder, dupfd, offset, count);
+        } else {
+            loop_->runInLoop(std::bind(&TcpConnection::sendFileInLoop, this, holder, dupfd, offset, count));
         }
     }
 }
 
-void TcpConnection::sendInLoop(const StringPiece& message)
+void TcpConnection::sendStringInLoop(const std::shared_ptr<const string>& message)
+{
+    sendInLoop(message->data(), message->size(), message);
+}
+
+void TcpConnection::sendBufferInLoop(const std::shared_ptr<Buffer>& message)
 {
-    sendInLoop(message.data(), message.size());
+    sendInLoop(message->peek(), message->readableBytes(), message);
 }
 
 void TcpConnection::sendInLoop(const void* data, size_t len)
+{
+    sendInLoop(data, len, std::shared_ptr<const void>());
+}
+
+void TcpConnection::sendInLoop(const void* data, size_t len, std::shared_ptr<const void> holder)
 {
     loop_->assertInLoopThread();
     ssize_t nwrote = 0;
@@ -109,8 +192,9 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
         return ;
     }
 
-    // 如果输出队列中没有任何内容，请尝试直接写入
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
+    // 如果输出队列中没有任何内容，请尝试直接写入(合并发送和完成模式时留到flushInLoop)
+    bool wasPending = isWritePending();
+    if (!wasPending && outputChain_.empty() && !writeBatching_ && !completionIo_) {
         nwrote = sockets::write(channel_->fd(), data, len);
         if (nwrote >= 0) {
             remaining = len - nwrote;
@@ -131,18 +215,181 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     assert(remaining <= len);
     // 如果没有全部发送完成
     if (!faultError && remaining > 0) {
-        size_t oldLen = outputBuffer_.readableBytes();
-        // 高水位回调
-        if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+        checkHighWaterMark(remaining);
+
+        /**
+         * 添加到输出链。因为输出链已经有待发送的数据，那么就不能先尝试发送了，因为这会造成数据乱序
+         * 有holder时只引用剩余的数据，否则拷贝一份
+         */
+        const char* rest = static_cast<const char *>(data) + nwrote;
+        if (holder) {
+            outputChain_.append(std::move(holder), rest, remaining);
+        } else {
+            outputChain_.append(rest, remaining);
+        }
+
+        startWriting(wasPending);
+    }
+}
+
+/**
+ * 输出链为空时先尝试直接sendfile，没发完的部分作为文件分段挂到输出链上
+ * 输出链不为空时只能排在后面，否则会造成数据乱序
+ */
+void TcpConnection::sendFileInLoop(const std::shared_ptr<const void>& holder, int fd, off_t offset, size_t count)
+{
+    loop_->assertInLoopThread();
+    size_t remaining = count;
+
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up sending file";
+        return ;
+    }
+
+    bool wasPending = isWritePending();
+    if (!wasPending && outputChain_.empty() && !writeBatching_ && !completionIo_) {
+        ssize_t nwrote = sockets::sendfile(channel_->fd(), fd, &offset, count);
+        // 边沿触发时发送缓冲区没满就不会有下一次可写事件，sendfile单次有长度上限，要一直发到EAGAIN为止
+        while (edgeTriggered_ && nwrote > 0 && implicit_cast<size_t>(nwrote) < remaining) {
+            remaining -= nwrote;
+            nwrote = sockets::sendfile(channel_->fd(), fd, &offset, remaining);
+        }
+        if (nwrote > 0) {
+            remaining -= nwrote;
+            if (remaining == 0 && writeCompleteCallback_) {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+        } else if (nwrote == 0) {
+            // 文件提前结束，边沿触发时可能已经发出了一部分
+            LOG_ERROR << "TcpConnection::sendFileInLoop [" << name_ << "] - file fd = " << fd << " ends at offset " << offset;
+            forceCloseInLoop();
+            return ;
+        } else if (errno != EWOULDBLOCK) {
+            // 比如fd不支持sendfile，文件剩下的部分已经无法发送
+            handleWriteError(errno, "TcpConnection::sendFileInLoop");
+            return ;
+        }
+    }
+
+    if (remaining > 0) {
+        checkHighWaterMark(remaining);
+        outputChain_.appendFile(holder, fd, offset, remaining);
+
+        startWriting(wasPending);
+    }
+}
+
+void TcpConnection::startWriting(bool wasPending)
+{
+    if (completionIo_) {
+        // 发送完成时会继续发送输出链中的数据
+        if (!wasPending) {
+            flushScheduled_ = true;
+            loop_->queueInLoop(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+        }
+    } else if (writeBatching_ && !wasPending) {
+        flushScheduled_ = true;
+        loop_->queueInLoop(std::bind(&TcpConnection::flushInLoop, shared_from_this()));
+    } else if (!channel_->isWriting()) {
+        channel_->enableWriting();
+    }
+}
+
+/**
+ * 合并发送: 把本轮循环中积累在输出链上的数据写到EAGAIN为止(writev一次可以带多个分段)
+ * 写不完的部分和普通模式一样等可写事件
+ */
+void TcpConnection::flushInLoop()
+{
+    loop_->assertInLoopThread();
+    flushScheduled_ = false;
+
+    if (state_ == kDisconnected) {
+        return;
+    }
+
+    // 数据已经由handleWrite发完了(边沿触发)，只需要继续关闭的过程
+    if (outputChain_.empty()) {
+        if (state_ == kDisconnecting) {
+            shutdownInLoop();
         }
+        return;
+    }
 
-        // 添加到缓冲区。因为outputBuffer_已经有待发送的数据，那么就不能先尝试发送了，因为这会造成数据乱序
-        outputBuffer_.append(static_cast<const char *>(data) + nwrote, remaining);
+    // 已经在等可写事件(或发送完成)的数据由handleWrite继续发送
+    if (isWritePending()) {
+        return;
+    }
+
+    if (completionIo_) {
+        sendOutputCompletion();
+        return;
+    }
 
-        if (!channel_->isWriting()) {
-            channel_->enableWriting();
+    int savedErrno = 0;
+    ssize_t n = 0;
+    do {
+        n = outputChain_.writeFd(channel_->fd(), &savedErrno);
+    } while (n >= 0 && !outputChain_.empty());
+
+    if (n < 0 && savedErrno != EWOULDBLOCK) {
+        handleWriteError(savedErrno, "TcpConnection::flushInLoop");
+        return;
+    }
+
+    if (outputChain_.empty()) {
+        if (writeCompleteCallback_) {
+            loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
         }
+        if (state_ == kDisconnecting) {
+            shutdownInLoop();
+        }
+    } else if (!channel_->isWriting()) {
+        channel_->enableWriting();
+    }
+}
+
+void TcpConnection::sendOutputCompletion()
+{
+    while (!outputChain_.empty()) {
+        struct iovec vec[OutputChain::kMaxIovecs];
+        int iovcnt = outputChain_.peekIovec(vec, OutputChain::kMaxIovecs);
+        if (iovcnt > 0) {
+            // 完成之前不能再往这些分段中合并数据，TcpConnection(holder)也要一直有效
+            outputChain_.sealTail();
+            loop_->submitSend(channel_.get(), vec, iovcnt, shared_from_this());
+            sendInFlight_ = true;
+            return;
+        }
+
+        // 链头是文件分段，sendfile不能提交给io_uring，同步发送，发不完等可写事件
+        int savedErrno = 0;
+        if (outputChain_.writeFd(channel_->fd(), &savedErrno) < 0) {
+            if (savedErrno == EWOULDBLOCK) {
+                if (!channel_->isWriting()) {
+                    channel_->enableWriting();
+                }
+            } else {
+                handleWriteError(savedErrno, "TcpConnection::sendOutputCompletion");
+            }
+            return;
+        }
+    }
+
+    if (writeCompleteCallback_) {
+        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    }
+    if (state_ == kDisconnecting) {
+        shutdownInLoop();
+    }
+}
+
+// 高水位回调
+void TcpConnection::checkHighWaterMark(size_t remaining)
+{
+    size_t oldLen = outputChain_.readableBytes();
+    if (oldLen + remaining >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
     }
 }
 
@@ -158,11 +405,16 @@ void TcpConnection::shutdown()
 void TcpConnection::shutdownInLoop()
 {
     loop_->assertInLoopThread();
-    if (!channel_->isWriting()) {
+    if (!isWritePending()) {
         socket_->shutdownWrite();
     }
 }
 
+bool TcpConnection::isWritePending() const
+{
+    return sendInFlight_ || flushScheduled_ || (channel_->isWriting() && (!edgeTriggered_ || !outputChain_.empty()));
+}
+
 void TcpConnection::forceClose()
 {
     // 使用比较和交换
@@ -228,6 +480,20 @@ void TcpConnection::startReadInLoop()
     }
 }
 
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, this));
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    loop_->assertInLoopThread();
+    if (reading_ || channel_->isReading()) {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
 // 收到连接
 void TcpConnection::connectEstablished()
 {
@@ -235,7 +501,27 @@ void TcpConnection::connectEstablished()
     assert(state_ == kConnecting);
     setState(kConnected);
     channel_->tie(shared_from_this());
-    channel_->enableReading();
+
+    if (completionIo_ && !loop_->supportsCompletionIo()) {
+        LOG_WARN << "TcpConnection::connectEstablished [" << name_ << "] - poller does not support completion I/O";
+        completionIo_ = false;
+    }
+
+    if (edgeTriggered_ && !loop_->supportsEdgeTriggered()) {
+        LOG_WARN << "TcpConnection::connectEstablished [" << name_ << "] - poller does not support edge-triggered mode";
+        edgeTriggered_ = false;
+    }
+
+    if (completionIo_) {
+        edgeTriggered_ = false;
+        channel_->setCompletionMode(Channel::kRecvCompletion);
+        channel_->enableReading();
+    } else if (edgeTriggered_) {
+        channel_->setEdgeTriggered(true);
+        channel_->enableReadingAndWriting();
+    } else {
+        channel_->enableReading();
+    }
 
     connectionCallback_(shared_from_this());
 }
@@ -252,12 +538,23 @@ void TcpConnection::connectDestroyed()
     }
     
     channel_->remove();
+    loop_->connectionDestroyed();
 }
 
 // 读取对端发送的消息。 把readable事件通过MessageCallback传达给客户
 void TcpConnection::handleRead(Timestamp receiveTime)
 {
     loop_->assertInLoopThread();
+    if (completionIo_) {
+        handleReadCompletion(receiveTime);
+        return;
+    }
+
+    if (edgeTriggered_) {
+        handleReadEdgeTriggered(receiveTime);
+        return;
+    }
+
     int saveErrno = 0;
 
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
@@ -272,25 +569,137 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     }
 }
 
+/**
+ * 边沿触发: 只有读到EAGAIN才会有下一次可读事件
+ * 一次最多读kMaxReadsPerEvent次，读到的数据只回调一次messageCallback_
+ * 读不完时把自己排到本轮循环的末尾继续读，先处理其它连接的事件
+ * 读出错时也不会再有事件(水平触发时下一次读会返回0)，直接关闭
+ * stopRead之后不再读，也不再排队，startRead重新关注可读事件时Poller会检查一次就绪状态
+ */
+void TcpConnection::handleReadEdgeTriggered(Timestamp receiveTime)
+{
+    if ((state_ != kConnected && state_ != kDisconnecting) || !reading_) {
+        return;
+    }
+
+    int saveErrno = 0;
+    ssize_t n = 0;
+    size_t total = 0;
+    int reads = 0;
+
+    do {
+        n = inputBuffer_.readFd(channel_->fd(), &saveErrno);
+        if (n > 0) {
+            total += n;
+        }
+    } while (n > 0 && ++reads < kMaxReadsPerEvent);
+
+    if (total > 0) {
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+    }
+
+    // 回调中可能已经关闭了连接
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;
+    }
+
+    if (n > 0) {
+        if (reading_) {
+            loop_->queueInLoop(std::bind(&TcpConnection::handleRead, shared_from_this(), receiveTime));
+        }
+    } else if (n == 0) {
+        handleClose();
+    } else if (saveErrno != EWOULDBLOCK) {
+        errno = saveErrno;
+        handleError();
+        handleClose();
+    }
+}
+
+/**
+ * 完成模式: 数据已经由io_uring收到共享的缓冲区中，一次取完，只回调一次messageCallback_
+ * 连接关闭之后才到达的数据(取消recv之前收到的)不再回调，由Poller在下一轮丢弃
+ * 对端关闭或出错之后recv请求已经终止，不会再有事件，直接关闭
+ */
+void TcpConnection::handleReadCompletion(Timestamp receiveTime)
+{
+    if (state_ != kConnected && state_ != kDisconnecting) {
+        return;
+    }
+
+    int saveErrno = 0;
+    ssize_t n = 0;
+    while ((n = loop_->takeReceived(channel_.get(), &inputBuffer_, &saveErrno)) > 0) {
+        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+
+        // 回调中可能已经关闭了连接
+        if (state_ != kConnected && state_ != kDisconnecting) {
+            return;
+        }
+    }
+
+    if (n == 0) {
+        handleClose();
+    } else if (saveErrno != EWOULDBLOCK) {
+        // SO_ERROR已经被recv取走，handleError读不到，直接记录recv的错误
+        errno = saveErrno;
+        LOG_SYSERR << "TcpConnection::handleReadCompletion [" << name_ << "]";
+        handleClose();
+    }
+}
+
 /**
  * 往对端写入消息.  自己处理writeable事件
- * 当socket变得可写时，Channel会调用TcpConnection::handleWrite()，这里会继续发送outputBuffer_中的数据
+ * 当socket变得可写时，Channel会调用TcpConnection::handleWrite()，这里会用一次writev(2)继续发送outputChain_中的数据
  * 一旦发送完毕，立刻停止观察writeable事件，避免busy loop
  * 另外如果这时连接正在关闭，则调用shutdownInLoop()，继续执行关闭过程
- * 这里不需要处理错误，因为一旦发生错误，handleRead()会读到0字节，继而关闭连接
+ * 写失败(不是EAGAIN)时剩下的数据已经无法按顺序送达，由handleWriteError关闭连接
  */
 void TcpConnection::handleWrite()
 {
     loop_->assertInLoopThread();
-    if (channel_->isWriting()) {
-        ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
+    if (completionIo_) {
+        ssize_t n = 0;
+        if (loop_->takeSendResult(channel_.get(), &n)) {
+            sendInFlight_ = false;
+            if (n == -EAGAIN) {
+                // 内核没有替我们等待(比如socket是非阻塞的旧内核)，等可写事件再提交
+                channel_->enableWriting();
+                return;
+            } else if (n < 0) {
+                handleWriteError(static_cast<int>(-n), "TcpConnection::handleWrite");
+                return;
+            }
+            outputChain_.retrieve(n);
+        } else if (channel_->isWriting()) {
+            // 链头的文件分段(或者EAGAIN)等到的可写事件
+            channel_->disableWriting();
+        } else {
+            return;
+        }
 
-        if (n > 0) {
-            outputBuffer_.retrieve(n);
+        if (state_ == kConnected || state_ == kDisconnecting) {
+            sendOutputCompletion();
+        }
+        return;
+    }
+
+    if (channel_->isWriting() && !outputChain_.empty()) {
+        int savedErrno = 0;
+        ssize_t n = outputChain_.writeFd(channel_->fd(), &savedErrno);
+
+        // 边沿触发时要写到输出链为空或者EAGAIN为止，否则不会再有可写事件
+        while (edgeTriggered_ && n >= 0 && !outputChain_.empty()) {
+            n = outputChain_.writeFd(channel_->fd(), &savedErrno);
+        }
+
+        if (n >= 0 || savedErrno == EWOULDBLOCK) {
             // 数据已经写完
-            if (outputBuffer_.readableBytes() == 0) {
-                // 把channel_状态设置成不可读
-                channel_->disableWriting();
+            if (outputChain_.empty()) {
+                // 把channel_状态设置成不可读，边沿触发时一直关注可写事件
+                if (!edgeTriggered_) {
+                    channel_->disableWriting();
+                }
                 if (writeCompleteCallback_) {
                     loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
                 }
@@ -301,7 +710,7 @@ void TcpConnection::handleWrite()
                 }
             }
         } else {
-            LOG_SYSERR << "TcpConnection::handleWrite";
+            handleWriteError(savedErrno, "TcpConnection::handleWrite");
         }
     } else{
         LOG_TRACE << "Connection fd = " << channel_->fd() << " is down, no more writing";
@@ -324,6 +733,17 @@ void TcpConnection::handleClose()
     closeCallback_(guardThis);
 }
 
+/**
+ * 输出链写失败(不是EAGAIN)之后，剩下的数据已经无法按顺序送达，继续发送只会打乱对端的消息边界
+ * 文件分段出错时socket本身是好的，handleRead不会发现，可写事件会一直触发，所以直接关闭连接
+ */
+void TcpConnection::handleWriteError(int savedErrno, const char* where)
+{
+    errno = savedErrno;
+    LOG_SYSERR << where << " [" << name_ << "]";
+    forceCloseInLoop();
+}
+
 // 输出错误信息
 void TcpConnection::handleError()
 {
@@ -7,6 +7,7 @@
 #include "networker/net/Callbacks.h"
 #include "networker/net/Buffer.h"
 #include "networker/net/InetAddress.h"
+#include "networker/net/OutputChain.h"
 
 #include <memory>   // shared_from_this
 #include <any>
@@ -35,6 +36,11 @@ namespace net
             const string name_; // 连接名称
             StateE state_;  // 使用原子变量，状态机
             bool reading_;  // 事件是否可读
+            bool edgeTriggered_;    // 边沿触发模式
+            bool writeBatching_;    // 合并一轮循环中的发送
+            bool flushScheduled_;   // 已经有flushInLoop在等待执行
+            bool completionIo_;     // 由io_uring代为收发
+            bool sendInFlight_;     // 完成模式下已经提交、还没有完成的发送
 
             std::unique_ptr<Socket> socket_;    // 新进连接的fd
             std::unique_ptr<Channel> channel_;  // ioLoop 的channel
@@ -50,9 +56,9 @@ namespace net
             CloseCallback closeCallback_;   // 关闭回调
             size_t highWaterMark_;
             
-            // 使用buffer作为缓冲
+            // 输入使用buffer作为缓冲，输出使用引用计数的分段链
             Buffer inputBuffer_;
-            Buffer outputBuffer_;
+            OutputChain outputChain_;
             std::any context_;
 
         public:
@@ -99,8 +105,27 @@ namespace net
 
             void send(const StringPiece& message);
 
+            void send(const char* message)
+            {
+                send(StringPiece(message));
+            }
+
             void send(Buffer *message); // 这个会交换数据
 
+            // 接管message的数据，不发生拷贝
+            void send(string&& message);
+
+            // 共享message的数据，不发生拷贝。适合把同一份数据广播给多个连接
+            void send(const std::shared_ptr<const string>& message);
+
+            /**
+             * 发送文件fd中 [offset, offset + count) 的数据，由sendfile(2)发送，不经过用户空间
+             * 与其它send按调用顺序交错发送，同样计入高水位和写入完成回调
+             * 内部会dup一份fd，调用者可以在返回后立即关闭自己的fd
+             * 线程安全
+             */
+            void sendFile(int fd, off_t offset, size_t count);
+
             void shutdown();    // 不是线程安全的，不能同时调用
 
             void forceClose();
@@ -109,6 +134,56 @@ namespace net
 
             void setTcpNoDelay(bool on);
 
+            /**
+             * 边沿触发模式: 读到EAGAIN为止(每次最多读固定次数，读不完的留到本轮循环末尾继续，保证连接之间的公平)
+             * 可写事件在建立连接时注册一次，之后不再随输出链的空/非空反复修改，省掉了大部分epoll_ctl(MOD)
+             * 必须在connectEstablished之前调用，Poller不支持边沿触发时(poll(2))退化为水平触发
+             */
+            void setEdgeTriggered(bool on)
+            {
+                assert(state_ == kConnecting);
+                edgeTriggered_ = on;
+            }
+
+            bool isEdgeTriggered() const
+            {
+                return edgeTriggered_;
+            }
+
+            /**
+             * 合并发送: IO线程中的send不再各自直接write，而是先挂到输出链上
+             * 在本轮循环处理完事件之后(doPendingFunctors)由一次writev(2)一起发出
+             * 适合一个消息回调中多次send的流水线协议，减少系统调用和小包，代价是多一次拷贝和一轮循环内的延迟
+             * 只能在IO线程中调用(比如连接回调中)
+             */
+            void setWriteBatching(bool on)
+            {
+                writeBatching_ = on;
+            }
+
+            bool isWriteBatching() const
+            {
+                return writeBatching_;
+            }
+
+            /**
+             * 完成模式: 不再等待就绪再read/write，而是由io_uring的multishot recv收数据，发送也提交给io_uring
+             * 收到的数据从共享的缓冲区拷贝到inputBuffer，send都先挂到输出链上，本轮循环末尾一次提交，和合并发送一样
+             * 每轮循环的所有收发和等待合并在一次io_uring_enter中
+             * 必须在connectEstablished之前调用，Poller不支持时(见EventLoop::supportsCompletionIo)退化为普通模式
+             * 优先于边沿触发
+             */
+            void setCompletionIo(bool on)
+            {
+                assert(state_ == kConnecting);
+                completionIo_ = on;
+            }
+
+            bool isCompletionIo() const
+            {
+                return completionIo_;
+            }
+
             void startRead();
 
             void stopRead();
@@ -155,9 +230,9 @@ namespace net
                 return &inputBuffer_;
             }
 
-            Buffer* outputBuffer()
+            OutputChain* outputChain()
             {
-                return &outputBuffer_;
+                return &outputChain_;
             }
 
             /**
@@ -178,20 +253,48 @@ namespace net
         private:
             void handleRead(Timestamp receiveTime);
 
+            void handleReadEdgeTriggered(Timestamp receiveTime);
+
+            void handleReadCompletion(Timestamp receiveTime);
+
             void handleWrite();
 
             void handleClose();
 
-            void handleError();
+            // 输出链写失败，记录错误并关闭连接
+            void handleWriteError(int savedErrno, const char* where);
 
-            void sendInLoop(const StringPiece& message);
+            void handleError();
 
             void sendInLoop(const void* message, size_t len);
 
+            // holder 不为空时，未写完的数据以引用的方式挂到输出链上
+            void sendInLoop(const void* message, size_t len, std::shared_ptr<const void> holder);
+
+            void sendStringInLoop(const std::shared_ptr<const string>& message);
+
+            void sendBufferInLoop(const std::shared_ptr<Buffer>& message);
+
+            void sendFileInLoop(const std::shared_ptr<const void>& holder, int fd, off_t offset, size_t count);
+
+            // 未写完的数据挂到输出链之前调用，必要时触发高水位回调
+            void checkHighWaterMark(size_t remaining);
+
             void shutdownInLoop();
 
             void forceCloseInLoop();
 
+            // 输出链中是否还有等待可写事件(或者等待合并发送)的数据。边沿触发时一直关注可写事件，所以还要看输出链
+            bool isWritePending() const;
+
+            // 输出链中有了新的数据，合并发送时安排一次flushInLoop，否则关注可写事件
+            void startWriting(bool wasPending);
+
+            void flushInLoop();
+
+            // 完成模式: 提交输出链头部的内存分段，链头是文件分段时同步sendfile，发完时继续写入完成和关闭的过程
+            void sendOutputCompletion();
+
             void setState(StateE s)
             {
                 state_ = s;
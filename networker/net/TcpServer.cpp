@@ -3,27 +3,64 @@
 #include "networker/net/EventLoop.h"
 #include "networker/net/EventLoopThreadPool.h"
 #include "networker/net/SocketsOps.h"
+#include "networker/base/CountDownLatch.h"
+#include "networker/base/Logging.h"
 
 #include <stdio.h>  // snprintf
 using namespace networker;
 using namespace networker::net;
 
+namespace
+{
+    void listenAcceptor(Acceptor* acceptor, CountDownLatch* latch)
+    {
+        acceptor->listen();
+        latch->countDown();
+    }
+
+    void destroyAcceptor(std::unique_ptr<Acceptor>* acceptor, CountDownLatch* latch)
+    {
+        acceptor->reset();
+        latch->countDown();
+    }
+};
+
 TcpServer::TcpServer(EventLoop *loop, const InetAddress& listenAddr, const string& nameArg, Option option)
-    :loop_(loop), ipPort_(listenAddr.toIpPort()), name_(nameArg),
-    acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+    :loop_(loop), listenAddr_(listenAddr), ipPort_(listenAddr.toIpPort()), name_(nameArg), option_(option),
+    acceptor_((option == kNoReusePort || option == kReusePort) ? new Acceptor(loop, listenAddr, option == kReusePort) : NULL),
+    reusePortCpuAffinity_(false), acceptBatchSize_(Acceptor::kDefaultBatchSize), edgeTriggered_(false), writeBatching_(false), completionIo_(false),
     threadPool_(new EventLoopThreadPool(loop, name_)),
-    connectionCallback_(defaultConnectionCallback), messageCallback_(defaultMessageCallback),
-    nextConnId_(1)
+    connectionCallback_(defaultConnectionCallback), messageCallback_(defaultMessageCallback)
 {
     // 设置 socket accept 的执行函数
-    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, _1, _2));
+    if (acceptor_) {
+        acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnection, this, _1, _2));
+    }
 }
 
 TcpServer::~TcpServer()
 {
     loop_->assertInLoopThread();
 
-    for (auto& item: connections_) {
+    // 先停止接受新连接，每个Acceptor要在它所属的IO线程中析构
+    if (!loopAcceptors_.empty()) {
+        std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+        assert(loops.size() == loopAcceptors_.size());
+
+        for (size_t i = 0; i < loopAcceptors_.size(); ++i) {
+            CountDownLatch latch(1);
+            loops[i]->runInLoop(std::bind(&destroyAcceptor, &loopAcceptors_[i], &latch));
+            latch.wait();
+        }
+    }
+
+    ConectionMap connections;
+    {
+        MutexLockGuard lock(mutex_);
+        connections.swap(connections_);
+    }
+
+    for (auto& item: connections) {
         TcpConnectionPtr conn(item.second);
         item.second.reset();
 
@@ -39,19 +76,97 @@ void TcpServer::setThreadNum(int numThreads)
     threadPool_->setThreadNum(numThreads);
 }
 
+void TcpServer::setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy)
+{
+    threadPool_->setDispatchPolicy(policy);
+}
+
 void TcpServer::start()
 {
     if (started_.getAndSet(1) == 0) {
         threadPool_->start(threadInitCallback_);
 
-        assert(!acceptor_->listenning());
+        if (acceptor_) {
+            assert(!acceptor_->listenning());
+            acceptor_->setBatchSize(acceptBatchSize_);
+            acceptor_->setCompletionIo(completionIo_);
 
-        loop_->runInLoop(
-            std::bind(&Acceptor::listen, get_pointer(acceptor_))
-        );
+            loop_->runInLoop(
+                std::bind(&Acceptor::listen, get_pointer(acceptor_))
+            );
+        } else {
+            loop_->runInLoop(std::bind(&TcpServer::startAcceptorsInLoop, this));
+        }
     }
 }
 
+/**
+ * 在基础线程中创建每个IO线程的Acceptor，然后依次到各个IO线程中listen
+ * 
+ * kReusePortPerLoop: 每个Acceptor一个监听socket，绑定到同一个地址
+ *  内核按listen的先后把socket加入SO_REUSEPORT组，逐个等待listen完成，组内的下标就和IO线程的下标一致
+ * 
+ * kSharedListenerPerLoop: 第一个Acceptor绑定地址，其余的dup它的监听socket，都以EPOLLEXCLUSIVE注册
+ */
+void TcpServer::startAcceptorsInLoop()
+{
+    loop_->assertInLoopThread();
+    assert(loopAcceptors_.empty());
+
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    for (EventLoop* ioLoop: loops) {
+        std::unique_ptr<Acceptor> acceptor;
+        if (option_ == kReusePortPerLoop) {
+            acceptor.reset(new Acceptor(ioLoop, listenAddr_, true));
+        } else if (loopAcceptors_.empty()) {
+            acceptor.reset(new Acceptor(ioLoop, listenAddr_, false));
+            acceptor->setExclusive(true);
+        } else {
+            acceptor.reset(new Acceptor(ioLoop, loopAcceptors_[0]->fd()));
+            acceptor->setExclusive(true);
+        }
+
+        acceptor->setBatchSize(acceptBatchSize_);
+        acceptor->setCompletionIo(completionIo_);
+        acceptor->setNewConnectionCallback(std::bind(&TcpServer::newConnectionInLoop, this, ioLoop, _1, _2));
+
+        CountDownLatch latch(1);
+        ioLoop->runInLoop(std::bind(&listenAcceptor, get_pointer(acceptor), &latch));
+        latch.wait();
+
+        MutexLockGuard lock(mutex_);
+        loopAcceptors_.push_back(std::move(acceptor));
+    }
+
+    if (option_ == kReusePortPerLoop && reusePortCpuAffinity_ && loopAcceptors_[0]->attachReusePortCpuFilter(static_cast<int>(loopAcceptors_.size()))) {
+        LOG_INFO << "TcpServer::startAcceptorsInLoop [" << name_ << "] - accept on cpu % " << loopAcceptors_.size();
+    }
+}
+
+TcpServer::AcceptStats TcpServer::acceptStats() const
+{
+    AcceptStats stats = {0, 0, 0, 0, 0};
+    std::vector<const Acceptor*> acceptors;
+    if (acceptor_) {
+        acceptors.push_back(get_pointer(acceptor_));
+    }
+    {
+        MutexLockGuard lock(mutex_);
+        for (const std::unique_ptr<Acceptor>& acceptor: loopAcceptors_) {
+            acceptors.push_back(get_pointer(acceptor));
+        }
+    }
+
+    for (const Acceptor* acceptor: acceptors) {
+        stats.wakeups += acceptor->wakeups();
+        stats.accepted += acceptor->accepted();
+        stats.fullBatches += acceptor->fullBatches();
+        stats.maxBatch = std::max(stats.maxBatch, acceptor->maxBatch());
+        stats.emfile += acceptor->emfile();
+    }
+    return stats;
+}
+
 /**
  * @param int sockfd 对端的的文件描述符
  * @param const InetAddress& peerAddr 对端的IP地址
@@ -65,12 +180,23 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 {
     // 在一个IO线程中
     loop_->assertInLoopThread();
-    // 获取一个io线程
-    EventLoop *ioLoop = threadPool_->getNextLoop();
+    // 按分配策略获取一个io线程
+    EventLoop *ioLoop = threadPool_->getLoopForConnection(peerAddr);
 
+    createConnection(ioLoop, sockfd, peerAddr);
+}
+
+// 由ioLoop自己的监听socket接受，连接直接在ioLoop中建立
+void TcpServer::newConnectionInLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
+    ioLoop->assertInLoopThread();
+    createConnection(ioLoop, sockfd, peerAddr);
+}
+
+void TcpServer::createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr)
+{
     char buf[64];
-    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_);
-    ++nextConnId_;
+    snprintf(buf, sizeof(buf), "-%s#%d", ipPort_.c_str(), nextConnId_.incrementAndGet());
 
     string connName = name_ + buf;
 
@@ -78,11 +204,17 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 
     TcpConnectionPtr conn(new TcpConnection(ioLoop, connName, sockfd, localAddr, peerAddr));
 
-    connections_[connName] = conn;
+    {
+        MutexLockGuard lock(mutex_);
+        connections_[connName] = conn;
+    }
 
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setEdgeTriggered(edgeTriggered_);
+    conn->setWriteBatching(writeBatching_);
+    conn->setCompletionIo(completionIo_);
     
     // 线程不安全
     conn->setCloseCallback(
@@ -93,7 +225,12 @@ void TcpServer::newConnection(int sockfd, const InetAddress& peerAddr)
 
 void TcpServer::removeConnection(const TcpConnectionPtr& conn)
 {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    if (acceptor_) {
+        loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    } else {
+        // 关闭回调本来就在conn所属的IO线程中调用
+        removeConnectionInLoop(conn);
+    }
 }
 
 /**
@@ -104,8 +241,17 @@ void TcpServer::removeConnection(const TcpConnectionPtr& conn)
  */
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn)
 {
-    loop_->assertInLoopThread();
-    size_t n = connections_.erase(conn->name());
+    if (acceptor_) {
+        loop_->assertInLoopThread();
+    } else {
+        conn->getLoop()->assertInLoopThread();
+    }
+
+    size_t n = 0;
+    {
+        MutexLockGuard lock(mutex_);
+        n = connections_.erase(conn->name());
+    }
     (void)n;
     assert(n == 1);
     EventLoop* ioLoop = conn->getLoop();
@@ -2,10 +2,13 @@
 #define NETWORKER_NET_TCPSERVER_H
 
 #include "networker/base/Atomic.h"
+#include "networker/base/MutexLock.h"
 #include "networker/base/Types.h"
+#include "networker/net/EventLoopThreadPool.h"
 #include "networker/net/TcpConnection.h"
 
 #include <map>
+#include <vector>
 
 namespace networker
 {
@@ -13,7 +16,6 @@ namespace net
 {
     class Acceptor;
     class EventLoop;
-    class EventLoopThreadPool;
 
     /**
      * TCP服务器，支持单线程和线程池模型
@@ -25,7 +27,28 @@ namespace net
 
             enum Option {
                 kNoReusePort,   // 不支持多个进程使用同一个IP + PORT
-                kReusePort  // 支持多个进程使用同一个IP + PORT
+                kReusePort,  // 支持多个进程使用同一个IP + PORT
+                /**
+                 * 每个IO线程各自持有一个设置了SO_REUSEPORT的监听socket，由内核把新连接分散到各个IO线程
+                 * 连接在哪个IO线程被接受，就在哪个IO线程中建立和销毁，不会跨线程
+                 * 监听socket在start()时才创建和绑定，listenAddr的端口不能为0
+                 */
+                kReusePortPerLoop,
+                /**
+                 * 只有一个监听socket，每个IO线程各自dup一份并以EPOLLEXCLUSIVE等待，新连接同样直接在接受它的IO线程中建立
+                 * 每次只唤醒一个等待者，不同于kReusePortPerLoop，某个IO线程阻塞时其它IO线程仍然可以接受排队的连接
+                 */
+                kSharedListenerPerLoop
+            };
+
+            // 所有Acceptor的统计之和(maxBatch取最大值)
+            struct AcceptStats
+            {
+                int64_t wakeups;        // 监听socket可读事件的次数
+                int64_t accepted;       // 接受的连接数
+                int64_t fullBatches;    // 一次可读事件用满了批量上限的次数，持续增长说明监听队列有积压
+                int64_t maxBatch;       // 一次可读事件接受的最多连接数
+                int64_t emfile;         // 因文件描述符耗尽而丢弃的连接数
             };
 
         private:
@@ -39,11 +62,29 @@ namespace net
 
             EventLoop* loop_;   // the acceptor loop
 
+            const InetAddress listenAddr_;
+
             const string ipPort_;
 
             const string name_;
 
-            std::unique_ptr<Acceptor> acceptor_;    // 避免暴露Acceptor， 使用Acceptor来获取新连接的fd
+            const Option option_;
+
+            std::unique_ptr<Acceptor> acceptor_;    // 避免暴露Acceptor， 使用Acceptor来获取新连接的fd，每个IO线程各自接受时为NULL
+
+            // 每个IO线程各自接受时与threadPool_->getAllLoops()一一对应，每个Acceptor只在自己的IO线程中使用
+            // 在基础线程中异步填充，由mutex_保护，acceptStats可能在其它线程中读取
+            std::vector<std::unique_ptr<Acceptor>> loopAcceptors_;
+
+            bool reusePortCpuAffinity_;
+
+            int acceptBatchSize_;
+
+            bool edgeTriggered_;
+
+            bool writeBatching_;
+
+            bool completionIo_;
 
             std::shared_ptr<EventLoopThreadPool> threadPool_;
 
@@ -57,7 +98,10 @@ namespace net
 
             AtomicInt32 started_;
 
-            int nextConnId_;    // 连接客户端数量
+            AtomicInt32 nextConnId_;    // 连接客户端数量
+
+            // 每个IO线程各自接受时会同时增删连接，也保护loopAcceptors_
+            mutable MutexLock mutex_;
 
             ConectionMap connections_;
 
@@ -90,7 +134,7 @@ namespace net
              * @param numThreads
              *  0 表示循环线程中的所有I/O，不会创建线程。这个是默认值
              *  1 表示另一个线程中的所有I/O
-             *  N 表示有N个线程的线程池，新的连接按循环分配
+             *  N 表示有N个线程的线程池，新的连接按分配策略(默认轮流)分配
              */
             void setThreadNum(int numThreads);
 
@@ -99,12 +143,69 @@ namespace net
                 threadInitCallback_ = cb;
             }
 
+            /**
+             * 选择新连接所在IO线程的策略，见EventLoopThreadPool::DispatchPolicy
+             * 只用于由acceptor线程分配连接的kNoReusePort和kReusePort，每个IO线程各自接受连接时由内核分配
+             */
+            void setDispatchPolicy(EventLoopThreadPool::DispatchPolicy policy);
+
             // 调用start函数之后生效
             std::shared_ptr<EventLoopThreadPool> threadPool()
             {
                 return threadPool_;
             }
 
+            /**
+             * kReusePortPerLoop模式下，给监听socket组挂上按CPU选择socket的BPF程序
+             * 第i个IO线程只接受在CPU i(模IO线程数)上处理的新连接，IO线程需要绑定到对应的CPU上才有意义
+             * 必须在 start函数之前调用
+             */
+            void setReusePortCpuAffinity(bool on)
+            {
+                reusePortCpuAffinity_ = on;
+            }
+
+            /**
+             * 监听socket每次可读时最多accept的连接数，默认Acceptor::kDefaultBatchSize
+             * 必须在 start函数之前调用
+             */
+            void setAcceptBatchSize(int batchSize)
+            {
+                assert(batchSize > 0);
+                acceptBatchSize_ = batchSize;
+            }
+
+            /**
+             * 新连接使用边沿触发模式，见TcpConnection::setEdgeTriggered
+             * 必须在 start函数之前调用
+             */
+            void setEdgeTriggered(bool on)
+            {
+                edgeTriggered_ = on;
+            }
+
+            /**
+             * 新连接合并一轮循环中的发送，见TcpConnection::setWriteBatching
+             * 必须在 start函数之前调用
+             */
+            void setWriteBatching(bool on)
+            {
+                writeBatching_ = on;
+            }
+
+            /**
+             * 使用io_uring的完成模式接受连接、收发数据，见TcpConnection::setCompletionIo
+             * 需要NETWORKER_USE_IO_URING，Poller不支持时退回就绪通知
+             * 必须在 start函数之前调用
+             */
+            void setCompletionIo(bool on)
+            {
+                completionIo_ = on;
+            }
+
+            // 在start之后调用，线程安全，还没有listen的Acceptor不计入
+            AcceptStats acceptStats() const;
+
             /**
              * 如果服务器没有侦听，则启动服务器
              * 多次调用是无损的
@@ -143,10 +244,18 @@ namespace net
             // 不是线程安全的，而是在循环
             void newConnection(int sockfd, const InetAddress& peerAddr);
 
+            // 每个IO线程各自接受的模式，在ioLoop中
+            void newConnectionInLoop(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+
+            void createConnection(EventLoop* ioLoop, int sockfd, const InetAddress& peerAddr);
+
+            // 在每个IO线程中创建监听socket并按顺序listen
+            void startAcceptorsInLoop();
+
             // 线程安全
             void removeConnection(const TcpConnectionPtr& conn);
 
-            // 不是线程安全的，而是在循环
+            // 不是线程安全的，而是在循环(每个IO线程各自接受时在conn所属的IO线程)
             void removeConnectionInLoop(const TcpConnectionPtr& conn);
     };
 };
@@ -51,6 +51,12 @@ namespace net
 
             void restart(Timestamp now);
 
+            // 直接修改到期时间，用于刷新计时器
+            void reset(Timestamp when)
+            {
+                expiration_ = when;
+            }
+
             static int64_t numCreated()
             {
                 return s_numCreated_.get();
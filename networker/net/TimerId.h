@@ -7,6 +7,13 @@ namespace net
 {
     class Timer;
 
+    // EventLoop 中定时器的实现方式
+    enum TimerBackend {
+        kDefaultTimerBackend,   // 设置了环境变量NETWORKER_USE_TIMING_WHEEL时使用kTimingWheel，否则使用kTimerQueue
+        kTimerQueue,            // 平衡二叉树，精确到微秒，插入/取消O(logN)
+        kTimingWheel            // 哈希时间轮，插入/取消/刷新O(1)，精度为一个tick
+    };
+
     class TimerId
     {
         private:
@@ -25,8 +32,9 @@ namespace net
             }
 
             friend class TimerQueue;
+            friend class TimingWheel;
     };
 };
 };
 
-#endif
\ No newline at end of file
+#endif
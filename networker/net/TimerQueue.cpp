@@ -128,6 +128,11 @@ void TimerQueue::cancel(TimerId timerId)
     loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
 }
 
+void TimerQueue::refresh(TimerId timerId, Timestamp when)
+{
+    loop_->runInLoop(std::bind(&TimerQueue::refreshInLoop, this, timerId, when));
+}
+
 // 新增定时事件
 void TimerQueue::addTimerInLoop(Timer* timer)
 {
@@ -164,6 +169,31 @@ void TimerQueue::cancelInLoop(TimerId timerId)
     assert(timers_.size() == activeTimers_.size());
 }
 
+// 先从两个集合中删除，修改到期时间后重新插入
+void TimerQueue::refreshInLoop(TimerId timerId, Timestamp when)
+{
+    loop_->assertInLoopThread();
+    assert(timers_.size() == activeTimers_.size());
+
+    ActiveTimer timer(timerId.timer_, timerId.sequence_);
+    ActiveTimerSet::iterator it = activeTimers_.find(timer);
+
+    if (it != activeTimers_.end()) {
+        Timer* t = it->first;
+        size_t n = timers_.erase(Entry(t->expiration(), t));
+        assert(n == 1);
+        (void)n;
+        activeTimers_.erase(it);
+
+        t->reset(when);
+        if (insert(t)) {
+            resetTimerfd(timerfd_, t->expiration());
+        }
+    }
+
+    assert(timers_.size() == activeTimers_.size());
+}
+
 void TimerQueue::handleRead()
 {
     loop_->assertInLoopThread();
@@ -177,6 +207,7 @@ void TimerQueue::handleRead()
     cancelingTimers_.clear();
     // 可以安全地在关键区域外回调
     for (const Entry& it : expired) {
+        loop_->recordTimerFired(it.second->expiration(), now);
         it.second->run();
     }
 
@@ -251,8 +282,8 @@ bool TimerQueue::insert(Timer *timer)
     Timestamp when = timer->expiration();
     TimerList::iterator it = timers_.begin();
     
-    // 如果timers_为空或者 when的时间大于timers_集合中的第一个元素的时间，意味着when的时间到期得最早，所以earliestChanged为true
-    if (it == timers_.end() || when.microSecondsSinceEpoch() > it->first.microSecondsSinceEpoch()) {
+    // 如果timers_为空或者 when的时间小于timers_集合中的第一个元素的时间，意味着when的时间到期得最早，所以earliestChanged为true
+    if (it == timers_.end() || when < it->first) {
         earliestChanged = true;
     }
 
@@ -67,12 +67,20 @@ namespace net
             TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
 
             void cancel(TimerId TimerId);
+
+            /**
+             * 把计时器的到期时间改为when，已经到期的计时器不能刷新
+             * 线程安全的
+             */
+            void refresh(TimerId timerId, Timestamp when);
         
         private:
             void addTimerInLoop(Timer* timer);
             
             void cancelInLoop(TimerId timerId);
 
+            void refreshInLoop(TimerId timerId, Timestamp when);
+
             // 当timerfd报警时调用
             void handleRead();
 
@@ -0,0 +1,276 @@
+#include "networker/net/TimingWheel.h"
+#include "networker/net/EventLoop.h"
+#include "networker/base/Logging.h"
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace networker
+{
+namespace net
+{
+    // 定义在TimerQueue.cpp
+    int createTimerfd();
+
+    // 以固定的间隔tick，interval为0时停止
+    void setTimerfdInterval(int timerfd, int64_t intervalUs)
+    {
+        struct itimerspec newValue;
+        memZero(&newValue, sizeof(newValue));
+
+        newValue.it_interval.tv_sec = static_cast<time_t>(intervalUs / Timestamp::kMicroSecondsPerSecond);
+        newValue.it_interval.tv_nsec = static_cast<long>((intervalUs % Timestamp::kMicroSecondsPerSecond) * 1000);
+        newValue.it_value = newValue.it_interval;
+
+        if (::timerfd_settime(timerfd, 0, &newValue, NULL)) {
+            LOG_SYSERR << "timerfd_settime() ";
+        }
+    }
+};
+};
+
+using namespace networker;
+using namespace networker::net;
+
+const int TimingWheel::kDefaultTickMs;
+const size_t TimingWheel::kDefaultNumSlots;
+
+TimingWheel::TimingWheel(EventLoop* loop, int tickMs, size_t numSlots)
+    : loop_(loop), tickUs_(static_cast<int64_t>(tickMs) * 1000), timerfd_(createTimerfd()),
+    timerfdChannel_(loop, timerfd_), slots_(numSlots), cursor_(0),
+    ticking_(false), callingExpiredTimers_(false)
+{
+    assert(tickMs > 0);
+    assert(numSlots > 0);
+    timerfdChannel_.setReadCallback(std::bind(&TimingWheel::handleRead, this));
+    timerfdChannel_.enableReading();
+}
+
+TimingWheel::~TimingWheel()
+{
+    timerfdChannel_.disableAll();
+    timerfdChannel_.remove();
+
+    ::close(timerfd_);
+
+    for (const EntryMap::value_type& item: entries_) {
+        delete item.second;
+    }
+}
+
+TimerId TimingWheel::addTimer(TimerCallback cb, Timestamp when, double interval)
+{
+    Entry* entry = new Entry(std::move(cb), when, interval);
+    TimerId timerId(&entry->timer_, entry->timer_.sequence());
+    loop_->runInLoop(std::bind(&TimingWheel::addTimerInLoop, this, entry));
+    return timerId;
+}
+
+void TimingWheel::cancel(TimerId timerId)
+{
+    loop_->runInLoop(std::bind(&TimingWheel::cancelInLoop, this, timerId));
+}
+
+void TimingWheel::refresh(TimerId timerId, Timestamp when)
+{
+    // 空闲超时的计时器通常在IO线程中刷新，避免构造functor
+    if (loop_->isInLoopThread()) {
+        refreshInLoop(timerId, when);
+    } else {
+        loop_->runInLoop(std::bind(&TimingWheel::refreshInLoop, this, timerId, when));
+    }
+}
+
+void TimingWheel::addTimerInLoop(Entry* entry)
+{
+    loop_->assertInLoopThread();
+    entries_[entry->timer_.sequence()] = entry;
+    link(entry);
+}
+
+void TimingWheel::cancelInLoop(TimerId timerId)
+{
+    loop_->assertInLoopThread();
+    Entry* entry = findEntry(timerId);
+    if (entry == NULL) {
+        return;
+    }
+
+    if (entry->expiring_) {
+        // 在到期回调中取消，可能已经在回调中被刷新而重新挂到槽上，由handleRead负责释放
+        assert(callingExpiredTimers_);
+        if (entry->linked_) {
+            unlink(entry);
+        }
+        entry->canceled_ = true;
+    } else {
+        unlink(entry);
+        entries_.erase(entry->timer_.sequence());
+        delete entry;
+        if (entries_.empty()) {
+            stopTicking();
+        }
+    }
+}
+
+void TimingWheel::refreshInLoop(TimerId timerId, Timestamp when)
+{
+    loop_->assertInLoopThread();
+    Entry* entry = findEntry(timerId);
+    if (entry == NULL || entry->canceled_) {
+        return;
+    }
+
+    if (entry->linked_) {
+        unlink(entry);
+    }
+    entry->timer_.reset(when);
+    link(entry);
+}
+
+TimingWheel::Entry* TimingWheel::findEntry(TimerId timerId) const
+{
+    /**
+     * 和TimerQueue一样，TimerId中保存的Timer*可能已经失效，不能直接解引用
+     * 先用序列号找到Entry，再比较地址
+     */
+    EntryMap::const_iterator it = entries_.find(timerId.sequence_);
+    if (it != entries_.end() && &it->second->timer_ == timerId.timer_) {
+        return it->second;
+    }
+    return NULL;
+}
+
+void TimingWheel::handleRead()
+{
+    loop_->assertInLoopThread();
+    uint64_t howmany;
+    ssize_t n = ::read(timerfd_, &howmany, sizeof(howmany));
+    if (n != sizeof(howmany)) {
+        LOG_ERROR << "TimingWheel::handleRead() reads " << n << " bytes instead of 8";
+    }
+
+    if (!ticking_) {
+        return;
+    }
+
+    Timestamp now(Timestamp::now());
+    std::vector<Entry*> expired;
+
+    // 按真实经过的时间推进游标，EventLoop繁忙时一次可能推进多个槽
+    while (cursorTime_.microSecondsSinceEpoch() + tickUs_ <= now.microSecondsSinceEpoch()) {
+        cursor_ = (cursor_ + 1) % slots_.size();
+        cursorTime_ = Timestamp(cursorTime_.microSecondsSinceEpoch() + tickUs_);
+
+        Entry* entry = slots_[cursor_];
+        while (entry) {
+            Entry* next = entry->next_;
+            if (entry->rounds_ > 0) {
+                --entry->rounds_;
+            } else {
+                unlink(entry);
+                entry->expiring_ = true;
+                expired.push_back(entry);
+            }
+            entry = next;
+        }
+    }
+
+    callingExpiredTimers_ = true;
+    for (Entry* entry: expired) {
+        if (!entry->canceled_) {
+            loop_->recordTimerFired(entry->timer_.expiration(), now);
+            entry->timer_.run();
+        }
+    }
+    callingExpiredTimers_ = false;
+
+    // 到期列表中的Entry只在这里释放，回调中的cancel只做标记
+    for (Entry* entry: expired) {
+        entry->expiring_ = false;
+        if (entry->linked_) {
+            // 在回调中被刷新过，已经重新挂到槽上
+            assert(!entry->canceled_);
+            continue;
+        }
+
+        if (entry->timer_.repeat() && !entry->canceled_) {
+            entry->timer_.restart(now);
+            link(entry);
+        } else {
+            entries_.erase(entry->timer_.sequence());
+            delete entry;
+        }
+    }
+
+    if (entries_.empty()) {
+        stopTicking();
+    }
+}
+
+/**
+ * 把计时器挂到到期时间对应的槽上
+ * ticks 为从游标开始需要经过的tick数，至少为1
+ */
+void TimingWheel::link(Entry* entry)
+{
+    assert(!entry->linked_);
+    if (!ticking_) {
+        startTicking();
+    }
+
+    int64_t delta = entry->timer_.expiration().microSecondsSinceEpoch() - cursorTime_.microSecondsSinceEpoch();
+    int64_t ticks = (delta + tickUs_ - 1) / tickUs_;
+    if (ticks < 1) {
+        ticks = 1;
+    }
+
+    const int64_t numSlots = static_cast<int64_t>(slots_.size());
+    size_t slot = static_cast<size_t>((static_cast<int64_t>(cursor_) + ticks) % numSlots);
+
+    entry->slot_ = slot;
+    entry->rounds_ = (ticks - 1) / numSlots;
+    entry->prev_ = NULL;
+    entry->next_ = slots_[slot];
+    if (slots_[slot]) {
+        slots_[slot]->prev_ = entry;
+    }
+    slots_[slot] = entry;
+    entry->linked_ = true;
+}
+
+void TimingWheel::unlink(Entry* entry)
+{
+    assert(entry->linked_);
+    if (entry->prev_) {
+        entry->prev_->next_ = entry->next_;
+    } else {
+        assert(slots_[entry->slot_] == entry);
+        slots_[entry->slot_] = entry->next_;
+    }
+
+    if (entry->next_) {
+        entry->next_->prev_ = entry->prev_;
+    }
+
+    entry->prev_ = NULL;
+    entry->next_ = NULL;
+    entry->linked_ = false;
+}
+
+// 时间轮从空变为非空时，从当前时间开始tick
+void TimingWheel::startTicking()
+{
+    assert(!ticking_);
+    ticking_ = true;
+    cursorTime_ = Timestamp::now();
+    setTimerfdInterval(timerfd_, tickUs_);
+}
+
+void TimingWheel::stopTicking()
+{
+    if (ticking_ && !callingExpiredTimers_) {
+        ticking_ = false;
+        setTimerfdInterval(timerfd_, 0);
+    }
+}
@@ -0,0 +1,129 @@
+#ifndef NETWORKER_NET_TIMINGWHEEL_H
+#define NETWORKER_NET_TIMINGWHEEL_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "networker/base/noncopyable.h"
+#include "networker/base/Timestamp.h"
+#include "networker/net/Callbacks.h"
+#include "networker/net/Channel.h"
+#include "networker/net/Timer.h"
+#include "networker/net/TimerId.h"
+
+namespace networker
+{
+namespace net
+{
+    class EventLoop;
+
+    /**
+     * 哈希时间轮，TimerQueue的替代实现
+     *
+     * 时间轮由numSlots个槽组成，每个槽是一个侵入式双向链表，游标每个tick前进一个槽
+     * 到期时间在一圈之外的计时器用rounds_记录还要转几圈，游标经过时递减
+     * 因此插入，取消，刷新都是O(1)，每个tick只需要遍历一个槽
+     *
+     * 只用一个timerfd以固定的tick驱动，时间轮为空时停止tick，不会唤醒空闲的EventLoop
+     * 精度为一个tick，适合大量连接的空闲超时这类对精度要求不高，但是频繁刷新的计时器
+     *
+     * TimingWheel的成员函数只能在其所属的IO线程调用，因此不必加锁
+     */
+    class TimingWheel: noncopyable
+    {
+        private:
+            struct Entry
+            {
+                Timer timer_;
+                Entry* prev_;
+                Entry* next_;
+                size_t slot_;
+                int64_t rounds_;    // 游标还要经过几次这个槽才到期
+                bool linked_;       // 是否挂在某个槽上
+                bool expiring_;     // 在handleRead的到期列表中，只能由handleRead释放
+                bool canceled_;     // 在到期回调的过程中被取消
+
+                Entry(TimerCallback cb, Timestamp when, double interval)
+                    : timer_(std::move(cb), when, interval), prev_(NULL), next_(NULL),
+                    slot_(0), rounds_(0), linked_(false), expiring_(false), canceled_(false)
+                {
+                }
+            };
+
+            // 以Timer的序列号为key，用于校验TimerId是否仍然有效
+            typedef std::unordered_map<int64_t, Entry*> EntryMap;
+
+            EventLoop* loop_;
+
+            const int64_t tickUs_;
+
+            const int timerfd_;
+
+            Channel timerfdChannel_;
+
+            // 每个槽链表的头结点
+            std::vector<Entry*> slots_;
+
+            size_t cursor_;
+
+            // 游标所在的槽对应的时间
+            Timestamp cursorTime_;
+
+            EntryMap entries_;
+
+            bool ticking_;
+
+            bool callingExpiredTimers_;
+
+        public:
+            static const int kDefaultTickMs = 10;
+
+            static const size_t kDefaultNumSlots = 4096;
+
+            explicit TimingWheel(EventLoop* loop, int tickMs = kDefaultTickMs, size_t numSlots = kDefaultNumSlots);
+
+            ~TimingWheel();
+
+            /**
+             * 计划在给定时间运行回调，如果 interval>0.0，则重复
+             * 线程安全的
+             */
+            TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+
+            void cancel(TimerId timerId);
+
+            /**
+             * 把计时器的到期时间改为when，不重新分配计时器
+             * 在IO线程中调用时是O(1)的，不会分配内存
+             */
+            void refresh(TimerId timerId, Timestamp when);
+
+            size_t size() const
+            {
+                return entries_.size();
+            }
+
+        private:
+            void addTimerInLoop(Entry* entry);
+
+            void cancelInLoop(TimerId timerId);
+
+            void refreshInLoop(TimerId timerId, Timestamp when);
+
+            Entry* findEntry(TimerId timerId) const;
+
+            // 当timerfd报警时调用
+            void handleRead();
+
+            void link(Entry* entry);
+
+            void unlink(Entry* entry);
+
+            void startTicking();
+
+            void stopTicking();
+    };
+};
+};
+
+#endif
@@ -0,0 +1,364 @@
+#include "networker/net/http/HttpContext.h"
+#include "networker/net/Buffer.h"
+
+#include <algorithm>
+
+using namespace networker;
+using namespace networker::net;
+
+namespace
+{
+    bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    // RFC 9110 5.6.2 token中允许的字符，字段名中不能有空白
+    bool isTokenChar(char c)
+    {
+        if (('0' <= c && c <= '9') || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z')) {
+            return true;
+        }
+        switch (c) {
+            case '!': case '#': case '$': case '%': case '&': case '\'': case '*': case '+':
+            case '-': case '.': case '^': case '_': case '`': case '|': case '~':
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    int hexValue(char c)
+    {
+        if ('0' <= c && c <= '9') {
+            return c - '0';
+        } else if ('a' <= c && c <= 'f') {
+            return c - 'a' + 10;
+        } else if ('A' <= c && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    /**
+     * 逐个检查Transfer-Encoding中以逗号分隔的编码，chunked必须是最后一个编码，并且只出现一次
+     * 多个Transfer-Encoding头按顺序拼接成一个列表，chunked在之前的头中已经出现过时同样是错误
+     */
+    bool parseTransferCodings(const StringPiece& value, bool* chunked)
+    {
+        const char* p = value.begin();
+        while (p < value.end()) {
+            const char* comma = std::find(p, value.end(), ',');
+            const char* begin = p;
+            const char* end = comma;
+            while (begin < end && isSpace(*begin)) {
+                ++begin;
+            }
+            while (begin < end && isSpace(end[-1])) {
+                --end;
+            }
+            if (begin < end) {
+                if (*chunked) {
+                    return false;
+                }
+                *chunked = HttpRequest::equalsIgnoreCase(StringPiece(begin, static_cast<int>(end - begin)), "chunked");
+            }
+            p = comma == value.end() ? comma : comma + 1;
+        }
+        return true;
+    }
+};
+
+const size_t HttpContext::kMaxHeaderSize;
+const size_t HttpContext::kMaxBodySize;
+const size_t HttpContext::kMaxRequestSize;
+
+HttpContext::HttpContext()
+{
+    reset();
+}
+
+void HttpContext::reset()
+{
+    state_ = kExpectRequestLine;
+    scanned_ = 0;
+    crlfScanned_ = 0;
+    version_ = HttpRequest::kUnknown;
+    numHeaders_ = 0;
+    bodyOffset_ = 0;
+    contentLength_ = 0;
+    chunkRemaining_ = 0;
+    trailerOffset_ = 0;
+    chunked_ = false;
+    lengthConflict_ = false;
+    // 保留容量，下一个分块编码的请求不用重新分配
+    chunkedBody_.clear();
+    request_.reset();
+}
+
+/**
+ * 按行解析请求行、请求头、chunk size行和trailer，scanned_始终指向下一行的开始
+ * 一行不完整时返回kNeedMore，crlfScanned_记住这一行已经查找过的位置，下次只检查新到达的数据
+ *
+ * 请求完整之前数据一直留在Buffer中，因此除了各部分的限制，整个请求(包括chunk size行、chunk-ext和trailer)
+ * 不能超过kMaxRequestSize，否则大量很小的chunk或者trailer行可以让连接无限制地缓存数据
+ */
+HttpContext::ParseResult HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime)
+{
+    const char* base = buf->peek();
+    const size_t readable = buf->readableBytes();
+
+    while (true) {
+        switch (state_) {
+            case kExpectRequestLine:
+            case kExpectHeaders:
+            case kExpectChunkSize:
+            case kExpectChunkTrailer: {
+                const char* begin = base + scanned_;
+                crlfScanned_ = std::max(crlfScanned_, scanned_);
+                const char* crlf = buf->findCRLF(&crlfScanned_);
+                // 请求行加请求头、整个trailer的总长度以及chunk size行的长度都不能超过kMaxHeaderSize
+                size_t limitFrom = scanned_;
+                if (state_ == kExpectRequestLine || state_ == kExpectHeaders) {
+                    limitFrom = 0;
+                } else if (state_ == kExpectChunkTrailer) {
+                    limitFrom = trailerOffset_;
+                }
+                const size_t lineEnd = crlf == NULL ? readable : crlf + 2 - base;
+                if (lineEnd - limitFrom > kMaxHeaderSize || lineEnd > kMaxRequestSize) {
+                    return kError;
+                }
+                if (crlf == NULL) {
+                    return kNeedMore;
+                }
+
+                scanned_ = lineEnd;
+                bool ok = true;
+                if (state_ == kExpectRequestLine) {
+                    ok = processRequestLine(base, begin, crlf);
+                } else if (state_ == kExpectHeaders) {
+                    ok = begin == crlf ? processHeadersEnd(base) : processHeaderLine(base, begin, crlf);
+                } else if (state_ == kExpectChunkSize) {
+                    ok = processChunkSize(begin, crlf);
+                } else if (begin == crlf) {
+                    // trailer中的字段忽略
+                    state_ = kGotAll;
+                }
+                if (!ok) {
+                    return kError;
+                }
+                break;
+            }
+
+            case kExpectBody:
+                if (readable - bodyOffset_ < contentLength_) {
+                    return kNeedMore;
+                }
+                scanned_ = bodyOffset_ + contentLength_;
+                state_ = kGotAll;
+                break;
+
+            case kExpectChunkData:
+                if (scanned_ + chunkRemaining_ + 2 > kMaxRequestSize) {
+                    return kError;
+                }
+                // chunk的数据和之后的CRLF一起到齐后再拷贝
+                if (readable - scanned_ < chunkRemaining_ + 2) {
+                    return kNeedMore;
+                }
+                if (base[scanned_ + chunkRemaining_] != '\r' || base[scanned_ + chunkRemaining_ + 1] != '\n') {
+                    return kError;
+                }
+                chunkedBody_.append(base + scanned_, chunkRemaining_);
+                scanned_ += chunkRemaining_ + 2;
+                chunkRemaining_ = 0;
+                state_ = kExpectChunkSize;
+                break;
+
+            case kGotAll:
+                buildRequest(base, receiveTime);
+                return kComplete;
+        }
+    }
+}
+
+void HttpContext::retrieveRequest(Buffer* buf)
+{
+    assert(state_ == kGotAll);
+    buf->retrieve(scanned_);
+    reset();
+}
+
+// METHOD SP request-target SP HTTP-version
+bool HttpContext::processRequestLine(const char* base, const char* begin, const char* end)
+{
+    const char* space = std::find(begin, end, ' ');
+    if (space == end) {
+        return false;
+    }
+    method_ = makeSpan(base, begin, space);
+
+    const char* start = space + 1;
+    space = std::find(start, end, ' ');
+    if (space == end || start == space) {
+        return false;
+    }
+    const char* question = std::find(start, space, '?');
+    path_ = makeSpan(base, start, question);
+    query_ = question == space ? makeSpan(base, space, space) : makeSpan(base, question + 1, space);
+
+    StringPiece version(space + 1, static_cast<int>(end - space - 1));
+    if (version == "HTTP/1.1") {
+        version_ = HttpRequest::kHttp11;
+    } else if (version == "HTTP/1.0") {
+        version_ = HttpRequest::kHttp10;
+    } else {
+        return false;
+    }
+
+    state_ = kExpectHeaders;
+    return true;
+}
+
+/**
+ * field-name ":" OWS field-value OWS
+ * 按RFC 9112 5.1，字段名和冒号之间有空白、以空白开始的行(obs-fold)都是错误
+ * 否则"Content-Length : 5"这样的字段不会被识别，请求体会被当成下一个流水线请求
+ */
+bool HttpContext::processHeaderLine(const char* base, const char* begin, const char* end)
+{
+    const char* colon = std::find(begin, end, ':');
+    if (colon == end || colon == begin || numHeaders_ == HttpRequest::kMaxHeaders) {
+        return false;
+    }
+    if (std::find_if_not(begin, colon, isTokenChar) != colon) {
+        return false;
+    }
+
+    const char* valueBegin = colon + 1;
+    const char* valueEnd = end;
+    while (valueBegin < valueEnd && isSpace(*valueBegin)) {
+        ++valueBegin;
+    }
+    while (valueBegin < valueEnd && isSpace(valueEnd[-1])) {
+        --valueEnd;
+    }
+
+    fields_[numHeaders_] = makeSpan(base, begin, colon);
+    values_[numHeaders_] = makeSpan(base, valueBegin, valueEnd);
+    ++numHeaders_;
+    return true;
+}
+
+/**
+ * 按RFC 9112 6.3决定请求体的边界，有歧义的请求按错误处理，防止request smuggling
+ * Transfer-Encoding的最后一个编码必须是chunked，否则无法确定请求体的长度
+ * 多个Content-Length的值必须相同
+ * Transfer-Encoding优先于Content-Length，两者同时出现时响应之后关闭连接
+ * 都没有时请求没有请求体
+ */
+bool HttpContext::processHeadersEnd(const char* base)
+{
+    bodyOffset_ = scanned_;
+
+    bool hasTransferEncoding = false;
+    bool hasContentLength = false;
+    for (int i = 0; i < numHeaders_; ++i) {
+        StringPiece field = toStringPiece(base, fields_[i]);
+        StringPiece value = toStringPiece(base, values_[i]);
+
+        if (HttpRequest::equalsIgnoreCase(field, "Transfer-Encoding")) {
+            hasTransferEncoding = true;
+            if (!parseTransferCodings(value, &chunked_)) {
+                return false;
+            }
+        } else if (HttpRequest::equalsIgnoreCase(field, "Content-Length")) {
+            if (value.empty()) {
+                return false;
+            }
+            size_t length = 0;
+            for (int j = 0; j < value.size(); ++j) {
+                if (value[j] < '0' || value[j] > '9') {
+                    return false;
+                }
+                length = length * 10 + (value[j] - '0');
+                if (length > kMaxBodySize) {
+                    return false;
+                }
+            }
+            if (hasContentLength && length != contentLength_) {
+                return false;
+            }
+            hasContentLength = true;
+            contentLength_ = length;
+        }
+    }
+
+    if (hasTransferEncoding && !chunked_) {
+        return false;
+    }
+    lengthConflict_ = hasTransferEncoding && hasContentLength;
+
+    if (chunked_) {
+        contentLength_ = 0;
+        state_ = kExpectChunkSize;
+    } else if (contentLength_ > 0) {
+        state_ = kExpectBody;
+    } else {
+        state_ = kGotAll;
+    }
+    return true;
+}
+
+// chunk-size [ chunk-ext ]，chunk-size是十六进制
+bool HttpContext::processChunkSize(const char* begin, const char* end)
+{
+    const char* sizeEnd = std::find(begin, end, ';');
+    while (sizeEnd > begin && isSpace(sizeEnd[-1])) {
+        --sizeEnd;
+    }
+    if (begin == sizeEnd) {
+        return false;
+    }
+
+    size_t size = 0;
+    for (const char* p = begin; p < sizeEnd; ++p) {
+        int v = hexValue(*p);
+        if (v < 0) {
+            return false;
+        }
+        size = size * 16 + v;
+        if (chunkedBody_.size() + size > kMaxBodySize) {
+            return false;
+        }
+    }
+
+    if (size == 0) {
+        trailerOffset_ = scanned_;
+        state_ = kExpectChunkTrailer;
+    } else {
+        chunkRemaining_ = size;
+        state_ = kExpectChunkData;
+    }
+    return true;
+}
+
+void HttpContext::buildRequest(const char* base, Timestamp receiveTime)
+{
+    request_.reset();
+    request_.setMethod(toStringPiece(base, method_));
+    request_.setVersion(version_);
+    request_.setPath(toStringPiece(base, path_));
+    request_.setQuery(toStringPiece(base, query_));
+    request_.setReceiveTime(receiveTime);
+    request_.setForceClose(lengthConflict_);
+    for (int i = 0; i < numHeaders_; ++i) {
+        request_.addHeader(toStringPiece(base, fields_[i]), toStringPiece(base, values_[i]));
+    }
+
+    if (chunked_) {
+        request_.setBody(StringPiece(chunkedBody_));
+    } else {
+        request_.setBody(StringPiece(base + bodyOffset_, static_cast<int>(contentLength_)));
+    }
+}
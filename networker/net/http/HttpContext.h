@@ -0,0 +1,126 @@
+#ifndef NETWORKER_NET_HTTP_HTTPCONTEXT_H
+#define NETWORKER_NET_HTTP_HTTPCONTEXT_H
+
+#include "networker/base/Types.h"
+#include "networker/net/http/HttpRequest.h"
+
+#include <stdint.h>
+
+namespace networker
+{
+namespace net
+{
+    class Buffer;
+
+    /**
+     * 每个连接一个的HTTP请求解析器，是一个增量的状态机
+     *
+     * 请求在完整之前不从Buffer中移除，解析的位置和各个字段都记录为相对于Buffer::peek()的偏移量
+     * 两次解析之间Buffer可能扩容或者移动数据，偏移量仍然有效，已经解析过的行不会重新扫描
+     * 请求完整时才把偏移量转换成指向Buffer的StringPiece，填入HttpRequest
+     *
+     * 支持Content-Length和chunked两种请求体，chunked的请求体解码到内部的string中
+     */
+    class HttpContext
+    {
+        public:
+            enum ParseResult
+            {
+                kNeedMore,      // 请求还不完整
+                kComplete,      // request()中是一个完整的请求
+                kError,         // 请求格式错误或者超过限制
+            };
+
+            // 请求行和请求头的最大长度
+            static const size_t kMaxHeaderSize = 64 * 1024;
+
+            static const size_t kMaxBodySize = 64 * 1024 * 1024;
+
+            // 整个请求在Buffer中的最大长度，给chunked的分块格式和trailer另外留出kMaxHeaderSize
+            static const size_t kMaxRequestSize = kMaxHeaderSize + kMaxBodySize + kMaxHeaderSize;
+
+        private:
+            enum State
+            {
+                kExpectRequestLine,
+                kExpectHeaders,
+                kExpectBody,
+                kExpectChunkSize,
+                kExpectChunkData,
+                kExpectChunkTrailer,
+                kGotAll,
+            };
+
+            // [offset, offset + len)，相对于请求的开始
+            struct Span
+            {
+                uint32_t offset;
+                uint32_t len;
+            };
+
+            State state_;
+            size_t scanned_;        // 已经解析过的字节数
+            size_t crlfScanned_;    // 当前行已经查找过CRLF的字节数，Buffer::findCRLF的续查位置
+            Span method_;
+            Span path_;
+            Span query_;
+            HttpRequest::Version version_;
+            Span fields_[HttpRequest::kMaxHeaders];
+            Span values_[HttpRequest::kMaxHeaders];
+            int numHeaders_;
+            size_t bodyOffset_;
+            size_t contentLength_;
+            size_t chunkRemaining_;
+            size_t trailerOffset_;  // trailer的开始
+            bool chunked_;
+            bool lengthConflict_;   // 同时有Transfer-Encoding和Content-Length
+            string chunkedBody_;
+            HttpRequest request_;
+
+        public:
+            HttpContext();
+
+            /**
+             * 从buf中继续解析当前的请求，不移除数据
+             * 返回kComplete后用request()处理请求，然后调用retrieveRequest
+             */
+            ParseResult parseRequest(Buffer* buf, Timestamp receiveTime);
+
+            const HttpRequest& request() const
+            {
+                assert(state_ == kGotAll);
+                return request_;
+            }
+
+            // 从buf中移除已经处理完的请求，准备解析下一个(流水线)请求
+            void retrieveRequest(Buffer* buf);
+
+            void reset();
+
+        private:
+            bool processRequestLine(const char* base, const char* begin, const char* end);
+
+            bool processHeaderLine(const char* base, const char* begin, const char* end);
+
+            // 请求头结束，决定请求体的格式
+            bool processHeadersEnd(const char* base);
+
+            bool processChunkSize(const char* begin, const char* end);
+
+            void buildRequest(const char* base, Timestamp receiveTime);
+
+            static Span makeSpan(const char* base, const char* begin, const char* end)
+            {
+                Span span = { static_cast<uint32_t>(begin - base), static_cast<uint32_t>(end - begin) };
+                return span;
+            }
+
+            static StringPiece toStringPiece(const char* base, Span span)
+            {
+                return StringPiece(base + span.offset, static_cast<int>(span.len));
+            }
+    };
+};
+};
+
+#endif
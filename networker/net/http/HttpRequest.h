@@ -0,0 +1,234 @@
+#ifndef NETWORKER_NET_HTTP_HTTPREQUEST_H
+#define NETWORKER_NET_HTTP_HTTPREQUEST_H
+
+#include "networker/base/StringPiece.h"
+#include "networker/base/Timestamp.h"
+#include "networker/base/Types.h"
+
+#include <assert.h>
+#include <strings.h>
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * HTTP请求
+     *
+     * 所有的StringPiece都直接指向连接的输入Buffer(分块编码的请求体指向HttpContext中解码后的数据)
+     * 解析请求头不分配内存，因此HttpRequest只在HttpServer的回调期间有效，需要保留的数据要自己拷贝
+     */
+    class HttpRequest
+    {
+        public:
+            enum Method
+            {
+                kInvalid, kGet, kPost, kHead, kPut, kDelete, kOptions, kPatch
+            };
+
+            enum Version
+            {
+                kUnknown, kHttp10, kHttp11
+            };
+
+            struct Header
+            {
+                StringPiece field;
+                StringPiece value;
+            };
+
+            // 超过这个数量的请求头按错误请求处理
+            static const int kMaxHeaders = 64;
+
+        private:
+            Method method_;
+            Version version_;
+            StringPiece path_;
+            StringPiece query_;
+            StringPiece body_;
+            Timestamp receiveTime_;
+            Header headers_[kMaxHeaders];
+            int numHeaders_;
+            bool forceClose_;
+
+        public:
+            HttpRequest(): method_(kInvalid), version_(kUnknown), numHeaders_(0), forceClose_(false)
+            {
+            }
+
+            void setVersion(Version v)
+            {
+                version_ = v;
+            }
+
+            Version getVersion() const
+            {
+                return version_;
+            }
+
+            bool setMethod(const StringPiece& m)
+            {
+                assert(method_ == kInvalid);
+                if (m == "GET") {
+                    method_ = kGet;
+                } else if (m == "POST") {
+                    method_ = kPost;
+                } else if (m == "HEAD") {
+                    method_ = kHead;
+                } else if (m == "PUT") {
+                    method_ = kPut;
+                } else if (m == "DELETE") {
+                    method_ = kDelete;
+                } else if (m == "OPTIONS") {
+                    method_ = kOptions;
+                } else if (m == "PATCH") {
+                    method_ = kPatch;
+                } else {
+                    method_ = kInvalid;
+                }
+                return method_ != kInvalid;
+            }
+
+            Method method() const
+            {
+                return method_;
+            }
+
+            const char* methodString() const
+            {
+                switch (method_) {
+                    case kGet:
+                        return "GET";
+
+                    case kPost:
+                        return "POST";
+
+                    case kHead:
+                        return "HEAD";
+
+                    case kPut:
+                        return "PUT";
+
+                    case kDelete:
+                        return "DELETE";
+
+                    case kOptions:
+                        return "OPTIONS";
+
+                    case kPatch:
+                        return "PATCH";
+
+                    default:
+                        return "UNKNOWN";
+                }
+            }
+
+            void setPath(const StringPiece& path)
+            {
+                path_ = path;
+            }
+
+            const StringPiece& path() const
+            {
+                return path_;
+            }
+
+            // 不含'?'
+            void setQuery(const StringPiece& query)
+            {
+                query_ = query;
+            }
+
+            const StringPiece& query() const
+            {
+                return query_;
+            }
+
+            void setBody(const StringPiece& body)
+            {
+                body_ = body;
+            }
+
+            const StringPiece& body() const
+            {
+                return body_;
+            }
+
+            void setReceiveTime(Timestamp t)
+            {
+                receiveTime_ = t;
+            }
+
+            Timestamp receiveTime() const
+            {
+                return receiveTime_;
+            }
+
+            /**
+             * 请求的边界不可靠(同时有Transfer-Encoding和Content-Length)，响应之后必须关闭连接
+             * 否则前面的代理可能按另一个头理解边界，把后面的数据当成下一个请求(request smuggling)
+             */
+            void setForceClose(bool on)
+            {
+                forceClose_ = on;
+            }
+
+            bool forceClose() const
+            {
+                return forceClose_;
+            }
+
+            // 请求头太多时返回false
+            bool addHeader(const StringPiece& field, const StringPiece& value)
+            {
+                if (numHeaders_ == kMaxHeaders) {
+                    return false;
+                }
+                headers_[numHeaders_].field = field;
+                headers_[numHeaders_].value = value;
+                ++numHeaders_;
+                return true;
+            }
+
+            // 字段名不区分大小写，没有时返回空的StringPiece
+            StringPiece getHeader(const StringPiece& field) const
+            {
+                for (int i = 0; i < numHeaders_; ++i) {
+                    if (equalsIgnoreCase(headers_[i].field, field)) {
+                        return headers_[i].value;
+                    }
+                }
+                return StringPiece();
+            }
+
+            static bool equalsIgnoreCase(const StringPiece& a, const StringPiece& b)
+            {
+                return a.size() == b.size() && ::strncasecmp(a.data(), b.data(), a.size()) == 0;
+            }
+
+            int numHeaders() const
+            {
+                return numHeaders_;
+            }
+
+            const Header& header(int i) const
+            {
+                assert(0 <= i && i < numHeaders_);
+                return headers_[i];
+            }
+
+            void reset()
+            {
+                method_ = kInvalid;
+                version_ = kUnknown;
+                path_.clear();
+                query_.clear();
+                body_.clear();
+                numHeaders_ = 0;
+                forceClose_ = false;
+            }
+    };
+};
+};
+
+#endif
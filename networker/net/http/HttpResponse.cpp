@@ -0,0 +1,97 @@
+#include "networker/net/http/HttpResponse.h"
+#include "networker/net/Buffer.h"
+
+#include <stdio.h>
+
+using namespace networker;
+using namespace networker::net;
+
+const char* HttpResponse::statusReason(HttpStatusCode code)
+{
+    switch (code) {
+        case k200Ok:
+            return "OK";
+
+        case k204NoContent:
+            return "No Content";
+
+        case k301MovedPermanently:
+            return "Moved Permanently";
+
+        case k400BadRequest:
+            return "Bad Request";
+
+        case k404NotFound:
+            return "Not Found";
+
+        case k413PayloadTooLarge:
+            return "Payload Too Large";
+
+        case k500InternalServerError:
+            return "Internal Server Error";
+
+        case k501NotImplemented:
+            return "Not Implemented";
+
+        default:
+            return "Unknown";
+    }
+}
+
+void HttpResponse::appendToBuffer(Buffer* output, bool withBody) const
+{
+    char buf[64];
+    snprintf(buf, sizeof buf, "HTTP/1.1 %d ", statusCode_);
+    output->append(buf);
+    output->append(statusMessage_.empty() ? statusReason(statusCode_) : statusMessage_.c_str());
+    output->append("\r\n");
+
+    if (chunked_) {
+        output->append("Transfer-Encoding: chunked\r\n");
+    } else {
+        snprintf(buf, sizeof buf, "Content-Length: %zu\r\n", body_.size());
+        output->append(buf);
+    }
+
+    if (closeConnection_) {
+        output->append("Connection: close\r\n");
+    } else {
+        output->append("Connection: Keep-Alive\r\n");
+    }
+
+    for (const auto& header: headers_) {
+        output->append(header.first);
+        output->append(": ");
+        output->append(header.second);
+        output->append("\r\n");
+    }
+    output->append("\r\n");
+
+    if (!withBody) {
+        return;
+    }
+
+    if (chunked_) {
+        appendChunk(output, body_);
+        appendLastChunk(output);
+    } else {
+        output->append(body_);
+    }
+}
+
+void HttpResponse::appendChunk(Buffer* output, const StringPiece& data)
+{
+    if (data.empty()) {
+        return;
+    }
+    char buf[32];
+    snprintf(buf, sizeof buf, "%x\r\n", static_cast<unsigned>(data.size()));
+    output->append(buf);
+    output->append(data);
+    output->append("\r\n");
+}
+
+void HttpResponse::appendLastChunk(Buffer* output)
+{
+    output->append("0\r\n\r\n");
+}
@@ -0,0 +1,126 @@
+#ifndef NETWORKER_NET_HTTP_HTTPRESPONSE_H
+#define NETWORKER_NET_HTTP_HTTPRESPONSE_H
+
+#include "networker/base/StringPiece.h"
+#include "networker/base/Types.h"
+
+#include <utility>
+#include <vector>
+
+namespace networker
+{
+namespace net
+{
+    class Buffer;
+
+    /**
+     * HTTP响应，由HttpServer的回调填写，然后整体序列化到连接的输出Buffer中
+     *
+     * 没有设置chunked时总是带Content-Length，这样连接可以保持(keep-alive)
+     * 设置chunked后响应体作为一个chunk发送并以last-chunk结束，appendChunk/appendLastChunk也可以单独用来组装分块的数据
+     */
+    class HttpResponse
+    {
+        public:
+            enum HttpStatusCode
+            {
+                kUnknown,
+                k200Ok = 200,
+                k204NoContent = 204,
+                k301MovedPermanently = 301,
+                k400BadRequest = 400,
+                k404NotFound = 404,
+                k413PayloadTooLarge = 413,
+                k500InternalServerError = 500,
+                k501NotImplemented = 501,
+            };
+
+        private:
+            HttpStatusCode statusCode_;
+            string statusMessage_;
+            std::vector<std::pair<string, string>> headers_;
+            bool closeConnection_;
+            bool chunked_;
+            string body_;
+
+        public:
+            explicit HttpResponse(bool close): statusCode_(kUnknown), closeConnection_(close), chunked_(false)
+            {
+            }
+
+            void setStatusCode(HttpStatusCode code)
+            {
+                statusCode_ = code;
+            }
+
+            HttpStatusCode statusCode() const
+            {
+                return statusCode_;
+            }
+
+            // 不设置时使用状态码的标准描述
+            void setStatusMessage(const string& message)
+            {
+                statusMessage_ = message;
+            }
+
+            void setCloseConnection(bool on)
+            {
+                closeConnection_ = on;
+            }
+
+            bool closeConnection() const
+            {
+                return closeConnection_;
+            }
+
+            void setChunked(bool on)
+            {
+                chunked_ = on;
+            }
+
+            bool chunked() const
+            {
+                return chunked_;
+            }
+
+            void setContentType(const string& contentType)
+            {
+                addHeader("Content-Type", contentType);
+            }
+
+            void addHeader(const string& field, const string& value)
+            {
+                headers_.push_back(std::make_pair(field, value));
+            }
+
+            void setBody(const string& body)
+            {
+                body_ = body;
+            }
+
+            void setBody(string&& body)
+            {
+                body_ = std::move(body);
+            }
+
+            const string& body() const
+            {
+                return body_;
+            }
+
+            // withBody为false时只写状态行和响应头(HEAD请求)
+            void appendToBuffer(Buffer* output, bool withBody = true) const;
+
+            // chunk-size CRLF data CRLF，data为空时不写任何东西(空chunk表示结束)
+            static void appendChunk(Buffer* output, const StringPiece& data);
+
+            // 0 CRLF CRLF
+            static void appendLastChunk(Buffer* output);
+
+            static const char* statusReason(HttpStatusCode code);
+    };
+};
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "networker/net/http/HttpServer.h"
+#include "networker/base/Logging.h"
+#include "networker/net/http/HttpContext.h"
+#include "networker/net/http/HttpRequest.h"
+#include "networker/net/http/HttpResponse.h"
+
+using namespace networker;
+using namespace networker::net;
+
+namespace
+{
+    void defaultHttpCallback(const HttpRequest&, HttpResponse* resp)
+    {
+        resp->setStatusCode(HttpResponse::k404NotFound);
+        resp->setCloseConnection(true);
+    }
+
+    const char kBadRequest[] = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+};
+
+HttpServer::HttpServer(EventLoop* loop, const InetAddress& listenAddr, const string& name, TcpServer::Option option)
+    : server_(loop, listenAddr, name, option), httpCallback_(defaultHttpCallback)
+{
+    server_.setConnectionCallback(std::bind(&HttpServer::onConnection, this, _1));
+    server_.setMessageCallback(std::bind(&HttpServer::onMessage, this, _1, _2, _3));
+}
+
+void HttpServer::start()
+{
+    LOG_WARN << "HttpServer[" << server_.name() << "] starts listening on " << server_.ipPort();
+    server_.start();
+}
+
+void HttpServer::onConnection(const TcpConnectionPtr& conn)
+{
+    if (conn->connected()) {
+        conn->setContext(HttpContext());
+    }
+}
+
+/**
+ * 流水线的请求逐个解析和回调，响应按请求的顺序追加到同一个Buffer中，处理完本次到达的数据后只发送一次
+ * 需要关闭连接时，之后的请求不再处理
+ */
+void HttpServer::onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime)
+{
+    if (!conn->connected()) {
+        // 正在关闭的连接，丢弃之后到达的请求
+        buf->retrieveAll();
+        return;
+    }
+
+    HttpContext* context = std::any_cast<HttpContext>(conn->getMutableContext());
+    assert(context != NULL);
+
+    Buffer output;
+    bool close = false;
+    while (!close) {
+        HttpContext::ParseResult result = context->parseRequest(buf, receiveTime);
+        if (result == HttpContext::kNeedMore) {
+            break;
+        } else if (result == HttpContext::kError) {
+            output.append(kBadRequest, sizeof kBadRequest - 1);
+            buf->retrieveAll();
+            close = true;
+        } else {
+            close = onRequest(context->request(), &output);
+            context->retrieveRequest(buf);
+        }
+    }
+
+    if (output.readableBytes() > 0) {
+        conn->send(&output);
+    }
+    if (close) {
+        conn->shutdown();
+    }
+}
+
+/**
+ * HTTP/1.1默认保持连接，除非请求中有Connection: close
+ * HTTP/1.0默认关闭连接，除非请求中有Connection: Keep-Alive
+ * 请求的边界有歧义时(HttpRequest::forceClose)总是关闭连接
+ */
+bool HttpServer::onRequest(const HttpRequest& req, Buffer* output)
+{
+    if (req.method() == HttpRequest::kInvalid) {
+        HttpResponse response(true);
+        response.setStatusCode(HttpResponse::k501NotImplemented);
+        response.appendToBuffer(output);
+        return true;
+    }
+
+    const StringPiece connection = req.getHeader("Connection");
+    const bool close = HttpRequest::equalsIgnoreCase(connection, "close") ||
+        (req.getVersion() == HttpRequest::kHttp10 && !HttpRequest::equalsIgnoreCase(connection, "Keep-Alive"));
+
+    HttpResponse response(close);
+    httpCallback_(req, &response);
+    if (req.forceClose()) {
+        response.setCloseConnection(true);
+    }
+    response.appendToBuffer(output, req.method() != HttpRequest::kHead);
+    return response.closeConnection();
+}
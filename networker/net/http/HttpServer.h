@@ -0,0 +1,68 @@
+#ifndef NETWORKER_NET_HTTP_HTTPSERVER_H
+#define NETWORKER_NET_HTTP_HTTPSERVER_H
+
+#include "networker/net/TcpServer.h"
+
+namespace networker
+{
+namespace net
+{
+    class HttpRequest;
+    class HttpResponse;
+
+    /**
+     * HTTP/1.1服务器
+     *
+     * 每个连接持有一个HttpContext作为上下文，增量地解析输入Buffer中的请求
+     * 支持keep-alive和流水线: 一次可读事件中到达的多个完整请求依次回调，它们的响应累积在同一个Buffer中，最后一起发送
+     * 回调中的HttpRequest直接指向输入Buffer，只在回调期间有效
+     */
+    class HttpServer: noncopyable
+    {
+        public:
+            typedef std::function<void (const HttpRequest&, HttpResponse*)> HttpCallback;
+
+        private:
+            TcpServer server_;
+            HttpCallback httpCallback_;
+
+        public:
+            HttpServer(EventLoop* loop, const InetAddress& listenAddr, const string& name,
+                TcpServer::Option option = TcpServer::kNoReusePort);
+
+            EventLoop* getLoop() const
+            {
+                return server_.getLoop();
+            }
+
+            // 不在IO线程中调用，需要线程安全
+            void setHttpCallback(const HttpCallback& cb)
+            {
+                httpCallback_ = cb;
+            }
+
+            void setThreadNum(int numThreads)
+            {
+                server_.setThreadNum(numThreads);
+            }
+
+            // 用于设置边缘触发、写合并等TcpServer的选项，start()之前调用
+            TcpServer* tcpServer()
+            {
+                return &server_;
+            }
+
+            void start();
+
+        private:
+            void onConnection(const TcpConnectionPtr& conn);
+
+            void onMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+
+            // 把响应追加到output中，返回是否需要关闭连接
+            bool onRequest(const HttpRequest& req, Buffer* output);
+    };
+};
+};
+
+#endif
@@ -1,15 +1,24 @@
 #include "networker/net/Poller.h"
 #include "networker/net/poller/PollPoller.h"
 #include "networker/net/poller/EPollPoller.h"
+#include "networker/net/poller/IoUringPoller.h"
+#include "networker/base/Logging.h"
 
 #include <stdlib.h>
 using namespace networker::net;
 
 Poller* Poller::newDefaultPoller(EventLoop* loop)
 {
-	if (::getenv("NETWORKER_USE_POLL")) {
-    	return new PollPoller(loop);
-  	} else {
-    	return new EPollPoller(loop);
-  	}
+    if (::getenv("NETWORKER_USE_POLL")) {
+        return new PollPoller(loop);
+    }
+
+    if (::getenv("NETWORKER_USE_IO_URING")) {
+        if (IoUringPoller::isSupported()) {
+            return new IoUringPoller(loop);
+        }
+        LOG_WARN << "io_uring is not available, fall back to epoll";
+    }
+
+    return new EPollPoller(loop);
 }
\ No newline at end of file
@@ -39,7 +39,7 @@ EPollPoller::~EPollPoller()
 
 Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
 {
-    LOG_TRACE << "fd total count " << channels_.size();
+    LOG_TRACE << "fd total count " << numChannels_;
 
     int numEvents = ::epoll_wait(epollfd_,  &*events_.begin(), static_cast<int>(events_.size()), timeoutMs);
 
@@ -75,12 +75,7 @@ void EPollPoller::fillActiveChannels(int numEvents, ChannelList* activeChannels)
 
     for (int i = 0; i < numEvents; ++i) {
         Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
-#ifndef NDEBUG
-        int fd = channel->fd();
-        ChannelMap::const_iterator it = channels_.find(fd);
-        assert(it != channels_.end());
-        assert(it->second == channel);
-#endif
+        assert(findChannel(channel->fd()) == channel);
         channel->set_revents(events_[i].events);
         activeChannels->push_back(channel);
     }
@@ -95,15 +90,12 @@ void EPollPoller::updateChannel(Channel* channel)
 
     if (index == kNew || index == kDeleted) {
         // a new one, add with EPOLL_CTL_ADD
-        int fd = channel->fd();
         if (index == kNew) {
-            assert(channels_.find(fd) == channels_.end());
             // 建立 fd 和 channel的映射
-            channels_[fd] = channel;
+            insertChannel(channel);
 
         } else { // index == kDeleted
-            assert(channels_.find(fd) != channels_.end());
-            assert(channels_[fd] == channel);
+            assert(findChannel(channel->fd()) == channel);
         }
 
         // 设置 channel index值，index = kAdded
@@ -112,10 +104,7 @@ void EPollPoller::updateChannel(Channel* channel)
 
     } else {
         // update existing one with EPOLL_CTL_MOD/DEL
-        int fd = channel->fd();
-        (void)fd;
-        assert(channels_.find(fd) != channels_.end());
-        assert(channels_[fd] == channel);
+        assert(findChannel(channel->fd()) == channel);
         assert(index == kAdded);
 
         if (channel->isNoneEvent()) {
@@ -133,16 +122,12 @@ void EPollPoller::removeChannel(Channel* channel)
     int fd = channel->fd();
     LOG_TRACE << "fd = " << fd;
 
-    assert(channels_.find(fd) != channels_.end());
-    assert(channels_[fd] == channel);
     assert(channel->isNoneEvent());
 
     int index = channel->index();
     assert(index == kAdded || index == kDeleted);
 
-    size_t n = channels_.erase(fd);
-    (void)n;
-    assert(n == 1);
+    eraseChannel(channel);
 
     if (index == kAdded) {
         update(EPOLL_CTL_DEL, channel);
@@ -156,9 +141,26 @@ void EPollPoller::update(int operation, Channel* channel)
     memZero(&event, sizeof event);
     // 设置 epoll 的配置项
     event.events = channel->events();
+    if (channel->isEdgeTriggered()) {
+        event.events |= EPOLLET;
+    }
     event.data.ptr = channel;
     int fd = channel->fd();
 
+#ifdef EPOLLEXCLUSIVE
+    // EPOLLEXCLUSIVE 只能用于 EPOLL_CTL_ADD，并且只能和下面这些事件一起使用(不能带EPOLLPRI, EPOLLRDHUP)
+    if (operation == EPOLL_CTL_ADD && channel->isExclusive()) {
+        event.events &= (EPOLLIN | EPOLLOUT | EPOLLERR | EPOLLHUP | EPOLLET);
+        event.events |= EPOLLEXCLUSIVE;
+        if (::epoll_ctl(epollfd_, operation, fd, &event) == 0) {
+            return;
+        }
+        // 内核不支持(4.5之前)，退化为普通的注册
+        LOG_SYSERR << "epoll_ctl op = ADD EPOLLEXCLUSIVE fd = " << fd;
+        event.events = channel->events() | (channel->isEdgeTriggered() ? EPOLLET : 0);
+    }
+#endif
+
     LOG_TRACE << "epoll_ctl op = " << operationToString(operation) << " fd = " << fd << " event = { " << channel->eventsToString() << " }";
 
     /**
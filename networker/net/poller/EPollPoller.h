@@ -30,6 +30,11 @@ namespace net
 
             void updateChannel(Channel *channel) override;
             void removeChannel(Channel *channel) override;
+
+            bool supportsEdgeTriggered() const override
+            {
+                return true;
+            }
         
         private:
             static const int kInitEventListSize = 26;
@@ -0,0 +1,973 @@
+#include "networker/net/poller/IoUringPoller.h"
+#include "networker/net/Buffer.h"
+#include "networker/net/Channel.h"
+#include "networker/base/Logging.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using namespace networker;
+using namespace networker::net;
+
+namespace
+{
+    const int kNew = -1;
+    const int kAdded = 1;
+    const int kDeleted = 2;
+
+    // 不关心结果的请求(POLL_REMOVE, ASYNC_CANCEL)的user_data
+    const uint64_t kIgnoreUserData = 0;
+
+    // user_data中请求的类型
+    enum RequestType
+    {
+        kPollRequest = 1,
+        kRecvRequest,
+        kAcceptRequest,
+        kSendRequest,
+    };
+
+    const int kTypeShift = 32;
+    const int kSeqShift = 35;
+    const uint32_t kSeqMask = (1u << 29) - 1;
+
+    // provided buffer ring的缓冲区组
+    const uint16_t kBufferGroup = 0;
+
+    /**
+     * provided buffer ring的第index项
+     * 内核的布局中bufs[0]与ring头部(tail)重叠，而<linux/io_uring.h>的__DECLARE_FLEX_ARRAY在C++中
+     * 多了一个占1字节的空结构体，br->bufs偏移了8字节，因此不能用bufs访问
+     */
+    struct io_uring_buf* bufferRingEntry(void* ring, unsigned index)
+    {
+        return static_cast<struct io_uring_buf*>(ring) + index;
+    }
+
+    uint64_t makeUserData(RequestType type, uint32_t seq, int fd)
+    {
+        return (static_cast<uint64_t>(seq) << kSeqShift) | (static_cast<uint64_t>(type) << kTypeShift) | static_cast<uint32_t>(fd);
+    }
+
+    // seq是不是在base之后(含)提交的请求，序号按29位回绕
+    bool seqAfter(uint32_t seq, uint32_t base)
+    {
+        return ((seq - base) & kSeqMask) <= (kSeqMask >> 1);
+    }
+
+    int ioUringSetup(unsigned entries, struct io_uring_params* params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int ioUringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void* arg, size_t argSize)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize));
+    }
+
+    int ioUringRegister(int ringFd, unsigned opcode, void* arg, unsigned nrArgs)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_register, ringFd, opcode, arg, nrArgs));
+    }
+
+    /**
+     * SINGLE_MMAP(5.4): SQ和CQ可以一次mmap
+     * NODROP(5.5): CQ满了内核也不会丢弃完成事件
+     * EXT_ARG(5.11): io_uring_enter可以带超时等待
+     */
+    const unsigned kRequiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+
+    bool probeIoUring()
+    {
+        struct io_uring_params params;
+        memZero(&params, sizeof(params));
+
+        int fd = ioUringSetup(2, &params);
+        if (fd < 0) {
+            LOG_SYSERR << "io_uring_setup";
+            return false;
+        }
+        ::close(fd);
+
+        if ((params.features & kRequiredFeatures) != kRequiredFeatures) {
+            LOG_WARN << "io_uring features " << params.features << " lack required " << kRequiredFeatures;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * 探测内核特性用的临时ring，一次只提交一个请求并等待它的第一个完成事件
+     * 很多特性不能从features判断(更早的内核对不认识的标志返回-EINVAL)，只能真正提交一次
+     */
+    class ProbeRing: noncopyable
+    {
+        private:
+            struct io_uring_params params_;
+            int ringFd_;
+            void* ring_;
+            size_t ringSize_;
+            void* sqes_;
+            size_t sqesSize_;
+
+        public:
+            ProbeRing(): ringFd_(-1), ring_(MAP_FAILED), ringSize_(0), sqes_(MAP_FAILED), sqesSize_(0)
+            {
+                memZero(&params_, sizeof(params_));
+                ringFd_ = ioUringSetup(2, &params_);
+                if (ringFd_ < 0) {
+                    return;
+                }
+
+                size_t sqSize = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+                size_t cqSize = params_.cq_off.cqes + params_.cq_entries * sizeof(struct io_uring_cqe);
+                ringSize_ = std::max(sqSize, cqSize);
+                sqesSize_ = params_.sq_entries * sizeof(struct io_uring_sqe);
+                ring_ = ::mmap(NULL, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+                sqes_ = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+            }
+
+            // 关闭ring会取消还在进行的请求
+            ~ProbeRing()
+            {
+                if (sqes_ != MAP_FAILED) {
+                    ::munmap(sqes_, sqesSize_);
+                }
+                if (ring_ != MAP_FAILED) {
+                    ::munmap(ring_, ringSize_);
+                }
+                if (ringFd_ >= 0) {
+                    ::close(ringFd_);
+                }
+            }
+
+            bool valid() const
+            {
+                return ringFd_ >= 0 && ring_ != MAP_FAILED && sqes_ != MAP_FAILED;
+            }
+
+            int fd() const
+            {
+                return ringFd_;
+            }
+
+            // 清零后的SQE，user_data为1
+            struct io_uring_sqe* sqe()
+            {
+                char* base = static_cast<char*>(ring_);
+                unsigned tail = *reinterpret_cast<unsigned*>(base + params_.sq_off.tail);
+                unsigned idx = tail & *reinterpret_cast<unsigned*>(base + params_.sq_off.ring_mask);
+                struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes_) + idx;
+                memZero(sqe, sizeof(*sqe));
+                sqe->user_data = 1;
+                return sqe;
+            }
+
+            // 提交sqe()返回的请求，等待并取出第一个完成事件
+            bool submitAndWait(struct io_uring_cqe* cqe)
+            {
+                char* base = static_cast<char*>(ring_);
+                unsigned* sqTail = reinterpret_cast<unsigned*>(base + params_.sq_off.tail);
+                unsigned* sqArray = reinterpret_cast<unsigned*>(base + params_.sq_off.array);
+                unsigned sqMask = *reinterpret_cast<unsigned*>(base + params_.sq_off.ring_mask);
+                unsigned* cqHead = reinterpret_cast<unsigned*>(base + params_.cq_off.head);
+                unsigned* cqTail = reinterpret_cast<unsigned*>(base + params_.cq_off.tail);
+                unsigned cqMask = *reinterpret_cast<unsigned*>(base + params_.cq_off.ring_mask);
+                struct io_uring_cqe* cqes = reinterpret_cast<struct io_uring_cqe*>(base + params_.cq_off.cqes);
+
+                unsigned tail = *sqTail;
+                sqArray[tail & sqMask] = tail & sqMask;
+                __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+
+                if (ioUringEnter(ringFd_, 1, 1, IORING_ENTER_GETEVENTS, NULL, 0) != 1) {
+                    return false;
+                }
+                unsigned head = *cqHead;
+                if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                    return false;
+                }
+                *cqe = cqes[head & cqMask];
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+    };
+
+    /**
+     * multishot poll(IORING_POLL_ADD_MULTI)从5.13开始支持，更早的内核对POLL_ADD的len返回-EINVAL
+     * 对已经可读的eventfd提交一次，看完成事件是否带IORING_CQE_F_MORE
+     */
+    bool probeMultishotPoll()
+    {
+        ProbeRing ring;
+        int evtfd = ::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        bool supported = false;
+        if (ring.valid() && evtfd >= 0) {
+            struct io_uring_sqe* sqe = ring.sqe();
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = evtfd;
+            sqe->poll32_events = POLLIN;
+            sqe->len = IORING_POLL_ADD_MULTI;
+
+            struct io_uring_cqe cqe;
+            supported = ring.submitAndWait(&cqe) && cqe.res > 0 && (cqe.flags & IORING_CQE_F_MORE);
+        }
+
+        if (evtfd >= 0) {
+            ::close(evtfd);
+        }
+
+        if (!supported) {
+            LOG_INFO << "io_uring multishot poll is not supported, edge-triggered channels are disabled";
+        }
+        return supported;
+    }
+
+    /**
+     * provided buffer ring(IORING_REGISTER_PBUF_RING)从5.19，multishot recv从6.0开始支持
+     * 注册一个只有一个缓冲区的ring，对已经有数据的socketpair提交一次multishot recv，
+     * 看完成事件是否从ring中取了缓冲区(IORING_CQE_F_BUFFER)并且请求还在继续(IORING_CQE_F_MORE)
+     */
+    bool probeCompletionIo()
+    {
+        const size_t kProbeSize = 4096;
+        void* mem = ::mmap(NULL, kProbeSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            return false;
+        }
+
+        int sv[2] = {-1, -1};
+        bool supported = false;
+        {
+            ProbeRing ring;
+            if (ring.valid() && ::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, sv) == 0) {
+                struct io_uring_buf_reg reg;
+                memZero(&reg, sizeof(reg));
+                reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+                reg.ring_entries = 1;
+                reg.bgid = kBufferGroup;
+
+                if (ioUringRegister(ring.fd(), IORING_REGISTER_PBUF_RING, &reg, 1) == 0) {
+                    // 缓冲区放在ring的后半页
+                    struct io_uring_buf_ring* br = static_cast<struct io_uring_buf_ring*>(mem);
+                    struct io_uring_buf* buf = bufferRingEntry(mem, 0);
+                    buf->addr = reinterpret_cast<uint64_t>(static_cast<char*>(mem) + kProbeSize / 2);
+                    buf->len = kProbeSize / 2;
+                    buf->bid = 0;
+                    __atomic_store_n(&br->tail, 1, __ATOMIC_RELEASE);
+
+                    if (::write(sv[1], "x", 1) == 1) {
+                        struct io_uring_sqe* sqe = ring.sqe();
+                        sqe->opcode = IORING_OP_RECV;
+                        sqe->fd = sv[0];
+                        sqe->ioprio = IORING_RECV_MULTISHOT;
+                        sqe->flags = IOSQE_BUFFER_SELECT;
+                        sqe->buf_group = kBufferGroup;
+
+                        struct io_uring_cqe cqe;
+                        supported = ring.submitAndWait(&cqe) && cqe.res == 1
+                                    && (cqe.flags & IORING_CQE_F_BUFFER) && (cqe.flags & IORING_CQE_F_MORE);
+                    }
+                }
+            }
+        }
+
+        if (sv[0] >= 0) {
+            ::close(sv[0]);
+            ::close(sv[1]);
+        }
+        // ring关闭之后内核不再引用这块内存
+        ::munmap(mem, kProbeSize);
+
+        if (!supported) {
+            LOG_INFO << "io_uring provided buffer rings or multishot recv are not supported, completion I/O is disabled";
+        }
+        return supported;
+    }
+};
+
+struct IoUringPoller::SendRequest
+{
+    struct msghdr msg;
+    struct iovec iov[kMaxSendIovecs];
+    std::shared_ptr<const void> holder;
+};
+
+const unsigned IoUringPoller::kRingEntries;
+const unsigned IoUringPoller::kBufferRingEntries;
+const unsigned IoUringPoller::kBufferSize;
+const int IoUringPoller::kMaxSendIovecs;
+
+bool IoUringPoller::isSupported()
+{
+    static const bool supported = probeIoUring();
+    return supported;
+}
+
+bool IoUringPoller::isMultishotPollSupported()
+{
+    static const bool supported = isSupported() && probeMultishotPoll();
+    return supported;
+}
+
+bool IoUringPoller::isCompletionIoSupported()
+{
+    static const bool supported = isSupported() && probeCompletionIo();
+    return supported;
+}
+
+IoUringPoller::IoUringPoller(EventLoop *loop)
+    : Poller(loop), ringFd_(-1), ringPtr_(NULL), ringSize_(0), sqTailLocal_(0), sqes_(NULL), sqesSize_(0), nextSeq_(0),
+    bufRing_(NULL), bufBase_(NULL), bufRingSize_(0), bufTail_(0)
+{
+    struct io_uring_params params;
+    memZero(&params, sizeof(params));
+
+    ringFd_ = ioUringSetup(kRingEntries, &params);
+    if (ringFd_ < 0) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller io_uring_setup";
+    }
+    assert((params.features & kRequiredFeatures) == kRequiredFeatures);
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ringSize_ = std::max(sqSize, cqSize);
+
+    ringPtr_ = ::mmap(NULL, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+    if (ringPtr_ == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller mmap ring";
+    }
+
+    sqesSize_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(NULL, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller::IoUringPoller mmap sqes";
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* ring = static_cast<char*>(ringPtr_);
+    sqHead_ = reinterpret_cast<unsigned*>(ring + params.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(ring + params.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned*>(ring + params.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned*>(ring + params.sq_off.ring_mask);
+    sqEntries_ = params.sq_entries;
+    sqTailLocal_ = *sqTail_;
+
+    cqHead_ = reinterpret_cast<unsigned*>(ring + params.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(ring + params.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(ring + params.cq_off.cqes);
+}
+
+IoUringPoller::~IoUringPoller()
+{
+    // 关闭ring会取消内核中所有的请求，之后才能释放请求引用的缓冲区和数据
+    ::munmap(sqes_, sqesSize_);
+    ::munmap(ringPtr_, ringSize_);
+    ::close(ringFd_);
+
+    if (bufRing_) {
+        ::munmap(bufRing_, bufRingSize_);
+    }
+
+    // 还没有完成的发送持有的TcpConnection在这里析构
+    for (FdState& state: fds_) {
+        if (state.send) {
+            sendRequests_.push_back(state.send);
+            state.send = NULL;
+        }
+    }
+    for (SendRequest* req: sendRequests_) {
+        delete req;
+    }
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList *activeChannels)
+{
+    LOG_TRACE << "fd total count " << numChannels_;
+
+    // 上一轮没有被取走的结果属于已经关闭的Channel
+    discardAllCompletions();
+    rearm();
+
+    unsigned minComplete = 0;
+    unsigned flags = 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memZero(&arg, sizeof(arg));
+
+    // 已经有完成事件时只提交，不等待
+    bool ready = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_;
+    if (timeoutMs != 0 && !ready) {
+        minComplete = 1;
+        flags |= IORING_ENTER_GETEVENTS;
+        if (timeoutMs > 0) {
+            ts.tv_sec = timeoutMs / 1000;
+            ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+            flags |= IORING_ENTER_EXT_ARG;
+        }
+    }
+
+    int ret = enter(minComplete, flags, (flags & IORING_ENTER_EXT_ARG) ? &arg : NULL, sizeof(arg));
+    int savedErrno = errno;
+
+    Timestamp now(Timestamp::now());
+
+    // ETIME: 超时，EINTR: 被信号打断，EBUSY/EAGAIN: CQ积压，先收割完成事件，下一轮再提交
+    if (ret < 0 && savedErrno != ETIME && savedErrno != EINTR && savedErrno != EBUSY && savedErrno != EAGAIN) {
+        errno = savedErrno;
+        LOG_SYSERR << "IoUringPoller::poll()";
+    }
+
+    int numEvents = fillActiveChannels(activeChannels);
+    if (numEvents > 0) {
+        LOG_TRACE << numEvents << " events happened";
+    } else {
+        LOG_TRACE << "nothing happened";
+    }
+
+    return now;
+}
+
+int IoUringPoller::fillActiveChannels(ChannelList *activeChannels)
+{
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kIgnoreUserData) {
+            continue;
+        }
+
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        RequestType type = static_cast<RequestType>((cqe.user_data >> kTypeShift) & 0x7);
+        uint32_t seq = static_cast<uint32_t>(cqe.user_data >> kSeqShift);
+        assert(static_cast<size_t>(fd) < fds_.size());
+
+        if (type == kRecvRequest || type == kAcceptRequest) {
+            handleRecvCompletion(fd, seq, type == kAcceptRequest, cqe);
+            continue;
+        }
+        if (type == kSendRequest) {
+            handleSendCompletion(fd, seq, cqe);
+            continue;
+        }
+
+        // 请求已经被取消或者被新的请求替换了
+        FdState& state = fds_[fd];
+        if (state.pollSeq != seq) {
+            continue;
+        }
+
+        // 一次性请求，或者内核终止了multishot请求，下一轮重新提交
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            state.pollSeq = 0;
+            rearmFds_.push_back(fd);
+        }
+
+        int revents = cqe.res;
+        if (revents < 0) {
+            LOG_ERROR << "IoUringPoller poll fd = " << fd << " error " << -revents;
+            revents = POLLERR;
+        }
+        markActive(fd, revents);
+    }
+
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+
+    for (int fd: activeFds_) {
+        Channel *channel = findChannel(fd);
+        assert(channel != NULL);
+        channel->set_revents(fds_[fd].revents);
+        activeChannels->push_back(channel);
+        fds_[fd].revents = 0;
+    }
+
+    int numEvents = static_cast<int>(activeFds_.size());
+    activeFds_.clear();
+    releasedHolders_.clear();
+    return numEvents;
+}
+
+/**
+ * 属于当前Channel的结果按顺序挂到fd上，等Channel处理可读事件时取走，包括取消(stopRead)之后才到达的数据
+ * 之前使用这个fd的Channel的结果直接丢弃: 归还缓冲区，关闭接受的连接
+ * 内核终止了multishot请求时，除非是对端关闭或出错(之后不会再有数据)，下一轮重新提交
+ * ENOBUFS表示缓冲区暂时用完了，本轮取走数据之后就会归还，不通知Channel
+ */
+void IoUringPoller::handleRecvCompletion(int fd, uint32_t seq, bool accept, const struct io_uring_cqe& cqe)
+{
+    FdState& state = fds_[fd];
+    int bufferId = (cqe.flags & IORING_CQE_F_BUFFER) ? static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    bool terminated = state.recvSeq == seq && !(cqe.flags & IORING_CQE_F_MORE);
+    if (terminated) {
+        state.recvSeq = 0;
+    }
+
+    Channel *channel = findChannel(fd);
+    if (channel == NULL || !seqAfter(seq, state.baseSeq) || cqe.res == -ECANCELED || cqe.res == -ENOBUFS) {
+        if (bufferId >= 0) {
+            recycleBuffer(bufferId);
+            publishBuffers();
+        }
+        if (accept && cqe.res >= 0) {
+            ::close(cqe.res);
+        }
+        if (terminated && cqe.res == -ENOBUFS) {
+            rearmFds_.push_back(fd);
+        }
+        return;
+    }
+
+    if (terminated && (accept || cqe.res > 0)) {
+        rearmFds_.push_back(fd);
+    }
+
+    Completion completion = {cqe.res, bufferId, -1, accept && cqe.res >= 0};
+    int index = static_cast<int>(completions_.size());
+    completions_.push_back(completion);
+    if (state.firstCompletion < 0) {
+        state.firstCompletion = index;
+        completionFds_.push_back(fd);
+    } else {
+        completions_[state.lastCompletion].next = index;
+    }
+    state.lastCompletion = index;
+
+    markActive(fd, POLLIN);
+}
+
+// 发送完成后释放SendRequest和holder，Channel已经移除(取消)时不再通知
+void IoUringPoller::handleSendCompletion(int fd, uint32_t seq, const struct io_uring_cqe& cqe)
+{
+    FdState& state = fds_[fd];
+    if (state.sendSeq != seq) {
+        return;
+    }
+
+    SendRequest* req = state.send;
+    releasedHolders_.push_back(std::move(req->holder));
+    sendRequests_.push_back(req);
+    state.send = NULL;
+    state.sendSeq = 0;
+
+    Channel *channel = findChannel(fd);
+    if (channel != NULL && seqAfter(seq, state.baseSeq) && cqe.res != -ECANCELED) {
+        state.hasSendResult = true;
+        state.sendResult = cqe.res;
+        markActive(fd, POLLOUT);
+    }
+}
+
+void IoUringPoller::markActive(int fd, int revents)
+{
+    FdState& state = fds_[fd];
+    if (state.revents == 0) {
+        activeFds_.push_back(fd);
+    }
+    state.revents |= revents;
+}
+
+ssize_t IoUringPoller::takeReceived(Channel *channel, Buffer *buf, int *savedErrno)
+{
+    Poller::assertInLoopThread();
+    FdState& state = fdState(channel->fd());
+    ssize_t total = 0;
+
+    while (state.firstCompletion >= 0) {
+        const Completion& completion = completions_[state.firstCompletion];
+        // 数据之后的对端关闭或错误留给下一次调用
+        if (completion.res <= 0 && total > 0) {
+            break;
+        }
+
+        state.firstCompletion = completion.next;
+        if (completion.res <= 0) {
+            if (completion.res == 0) {
+                return 0;
+            }
+            *savedErrno = -completion.res;
+            return -1;
+        }
+
+        assert(completion.bufferId >= 0);
+        buf->append(bufBase_ + static_cast<size_t>(completion.bufferId) * kBufferSize, completion.res);
+        recycleBuffer(completion.bufferId);
+        total += completion.res;
+    }
+
+    if (total > 0) {
+        publishBuffers();
+        return total;
+    }
+    *savedErrno = EWOULDBLOCK;
+    return -1;
+}
+
+int IoUringPoller::takeAccepted(Channel *channel, int *savedErrno)
+{
+    Poller::assertInLoopThread();
+    FdState& state = fdState(channel->fd());
+    if (state.firstCompletion < 0) {
+        *savedErrno = EWOULDBLOCK;
+        return -1;
+    }
+
+    const Completion& completion = completions_[state.firstCompletion];
+    state.firstCompletion = completion.next;
+    if (completion.res < 0) {
+        *savedErrno = -completion.res;
+        return -1;
+    }
+    return completion.res;
+}
+
+void IoUringPoller::submitSend(Channel *channel, const struct iovec *iov, int iovcnt, std::shared_ptr<const void> holder)
+{
+    Poller::assertInLoopThread();
+    int fd = channel->fd();
+    FdState& state = fdState(fd);
+    assert(state.sendSeq == 0 && !state.hasSendResult);
+    assert(iovcnt > 0);
+
+    SendRequest* req = NULL;
+    if (sendRequests_.empty()) {
+        req = new SendRequest;
+    } else {
+        req = sendRequests_.back();
+        sendRequests_.pop_back();
+    }
+
+    iovcnt = std::min(iovcnt, kMaxSendIovecs);
+    std::copy(iov, iov + iovcnt, req->iov);
+    memZero(&req->msg, sizeof(req->msg));
+    req->msg.msg_iov = req->iov;
+    req->msg.msg_iovlen = iovcnt;
+    req->holder = std::move(holder);
+
+    uint32_t seq = nextSeq();
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&req->msg);
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = makeUserData(kSendRequest, seq, fd);
+
+    state.sendSeq = seq;
+    state.send = req;
+}
+
+bool IoUringPoller::takeSendResult(Channel *channel, ssize_t *result)
+{
+    Poller::assertInLoopThread();
+    FdState& state = fdState(channel->fd());
+    if (!state.hasSendResult) {
+        return false;
+    }
+    state.hasSendResult = false;
+    *result = state.sendResult;
+    return true;
+}
+
+void IoUringPoller::updateChannel(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    const int index = channel->index();
+    const int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd << " events = " << channel->events() << " index = " << index;
+
+    if (index == kNew) {
+        insertChannel(channel);
+        fdState(fd).baseSeq = (nextSeq_ + 1) & kSeqMask;
+    } else {
+        assert(findChannel(fd) == channel);
+    }
+
+    // 修改事件 = 取消旧的poll请求 + 提交新的请求，都在下一次poll时一起提交。recv/accept请求只在不再关注可读事件时取消
+    cancelPoll(fd);
+    if (channel->isNoneEvent()) {
+        cancelRecv(fd);
+        channel->set_index(kDeleted);
+    } else {
+        channel->set_index(kAdded);
+        arm(channel);
+    }
+}
+
+void IoUringPoller::removeChannel(Channel *channel)
+{
+    Poller::assertInLoopThread();
+    int fd = channel->fd();
+    LOG_TRACE << "fd = " << fd;
+
+    assert(channel->isNoneEvent());
+    assert(channel->index() == kAdded || channel->index() == kDeleted);
+
+    // 正在进行的发送由holder保证fd一直打开，等它的完成事件再释放SendRequest
+    cancelPoll(fd);
+    cancelRecv(fd);
+    cancelSend(fd);
+    discardCompletions(fd);
+    fdState(fd).hasSendResult = false;
+
+    eraseChannel(channel);
+    channel->set_index(kNew);
+}
+
+struct io_uring_sqe* IoUringPoller::getSqe()
+{
+    // 没有SQPOLL，提交时内核会取走所有的SQE，所以SQ满了先提交一次
+    if (sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        if (enter(0, 0, NULL, 0) < 0) {
+            LOG_SYSERR << "IoUringPoller::getSqe submit";
+        }
+    }
+    assert(sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) < sqEntries_);
+
+    unsigned idx = sqTailLocal_ & sqMask_;
+    sqArray_[idx] = idx;
+    ++sqTailLocal_;
+
+    struct io_uring_sqe* sqe = &sqes_[idx];
+    memZero(sqe, sizeof(*sqe));
+    return sqe;
+}
+
+int IoUringPoller::enter(unsigned minComplete, unsigned flags, const void* arg, size_t argSize)
+{
+    __atomic_store_n(sqTail_, sqTailLocal_, __ATOMIC_RELEASE);
+    unsigned toSubmit = sqTailLocal_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    return ioUringEnter(ringFd_, toSubmit, minComplete, flags, arg, argSize);
+}
+
+// 序号0表示没有请求
+uint32_t IoUringPoller::nextSeq()
+{
+    nextSeq_ = (nextSeq_ + 1) & kSeqMask;
+    if (nextSeq_ == 0) {
+        ++nextSeq_;
+    }
+    return nextSeq_;
+}
+
+IoUringPoller::FdState& IoUringPoller::fdState(int fd)
+{
+    if (static_cast<size_t>(fd) >= fds_.size()) {
+        FdState empty = {0, 0, 0, 0, 0, -1, -1, false, 0, NULL};
+        fds_.resize(std::max(static_cast<size_t>(fd) + 1, fds_.size() * 2), empty);
+    }
+    return fds_[fd];
+}
+
+void IoUringPoller::arm(Channel *channel)
+{
+    FdState& state = fdState(channel->fd());
+    int events = channel->events();
+
+    if (channel->completionMode() != Channel::kNoCompletion) {
+        if (!(events & POLLIN)) {
+            cancelRecv(channel->fd());
+        } else if (state.recvSeq == 0) {
+            armRecv(channel);
+        }
+        events &= ~(POLLIN | POLLPRI);
+    }
+
+    if (events != 0 && state.pollSeq == 0) {
+        armPoll(channel, events);
+    }
+}
+
+void IoUringPoller::armPoll(Channel *channel, int events)
+{
+    int fd = channel->fd();
+    uint32_t seq = nextSeq();
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(events);
+    if (channel->isEdgeTriggered()) {
+        sqe->len = IORING_POLL_ADD_MULTI;
+    }
+    sqe->user_data = makeUserData(kPollRequest, seq, fd);
+
+    fdState(fd).pollSeq = seq;
+}
+
+void IoUringPoller::armRecv(Channel *channel)
+{
+    assert(isCompletionIoSupported());
+    int fd = channel->fd();
+    uint32_t seq = nextSeq();
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->fd = fd;
+    if (channel->completionMode() == Channel::kAcceptCompletion) {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+        sqe->user_data = makeUserData(kAcceptRequest, seq, fd);
+    } else {
+        if (bufRing_ == NULL) {
+            setupBufferRing();
+        }
+        sqe->opcode = IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufferGroup;
+        sqe->user_data = makeUserData(kRecvRequest, seq, fd);
+    }
+
+    fdState(fd).recvSeq = seq;
+}
+
+void IoUringPoller::cancelPoll(int fd)
+{
+    FdState& state = fdState(fd);
+    if (state.pollSeq == 0) {
+        return;
+    }
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(kPollRequest, state.pollSeq, fd);
+    sqe->user_data = kIgnoreUserData;
+
+    state.pollSeq = 0;
+}
+
+void IoUringPoller::cancelRecv(int fd)
+{
+    FdState& state = fdState(fd);
+    if (state.recvSeq == 0) {
+        return;
+    }
+
+    Channel *channel = findChannel(fd);
+    bool accept = channel != NULL && channel->completionMode() == Channel::kAcceptCompletion;
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(accept ? kAcceptRequest : kRecvRequest, state.recvSeq, fd);
+    sqe->user_data = kIgnoreUserData;
+
+    state.recvSeq = 0;
+}
+
+void IoUringPoller::cancelSend(int fd)
+{
+    FdState& state = fdState(fd);
+    if (state.sendSeq == 0) {
+        return;
+    }
+
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = makeUserData(kSendRequest, state.sendSeq, fd);
+    sqe->user_data = kIgnoreUserData;
+}
+
+// 重新提交上一轮结束了的请求(一次性poll请求，被内核终止的multishot请求)，处理事件时已经重新提交过或者已经移除的Channel跳过
+void IoUringPoller::rearm()
+{
+    for (int fd: rearmFds_) {
+        Channel *channel = findChannel(fd);
+        if (channel && channel->index() == kAdded) {
+            assert(!channel->isNoneEvent());
+            arm(channel);
+        }
+    }
+    rearmFds_.clear();
+}
+
+void IoUringPoller::discardCompletions(int fd)
+{
+    FdState& state = fdState(fd);
+    for (int i = state.firstCompletion; i >= 0; i = completions_[i].next) {
+        const Completion& completion = completions_[i];
+        if (completion.bufferId >= 0) {
+            recycleBuffer(completion.bufferId);
+        } else if (completion.accepted) {
+            ::close(completion.res);
+        }
+    }
+    state.firstCompletion = -1;
+    state.lastCompletion = -1;
+    publishBuffers();
+}
+
+void IoUringPoller::discardAllCompletions()
+{
+    for (int fd: completionFds_) {
+        if (fds_[fd].firstCompletion >= 0) {
+            LOG_TRACE << "fd = " << fd << " discard completions";
+            discardCompletions(fd);
+        }
+        fds_[fd].lastCompletion = -1;
+    }
+    completionFds_.clear();
+    completions_.clear();
+}
+
+/**
+ * ring和缓冲区一次mmap，ring在前(要求页对齐)，缓冲区在后
+ * 缓冲区被内核写过之后才占用物理内存
+ */
+void IoUringPoller::setupBufferRing()
+{
+    size_t ringBytes = kBufferRingEntries * sizeof(struct io_uring_buf);
+    bufRingSize_ = ringBytes + static_cast<size_t>(kBufferRingEntries) * kBufferSize;
+    void* mem = ::mmap(NULL, bufRingSize_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        LOG_SYSFATAL << "IoUringPoller::setupBufferRing mmap";
+    }
+    bufRing_ = static_cast<struct io_uring_buf_ring*>(mem);
+    bufBase_ = static_cast<char*>(mem) + ringBytes;
+
+    struct io_uring_buf_reg reg;
+    memZero(&reg, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(mem);
+    reg.ring_entries = kBufferRingEntries;
+    reg.bgid = kBufferGroup;
+    if (ioUringRegister(ringFd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LOG_SYSFATAL << "IoUringPoller::setupBufferRing register";
+    }
+
+    for (unsigned i = 0; i < kBufferRingEntries; ++i) {
+        recycleBuffer(static_cast<int>(i));
+    }
+    publishBuffers();
+}
+
+void IoUringPoller::recycleBuffer(int bufferId)
+{
+    struct io_uring_buf* buf = bufferRingEntry(bufRing_, bufTail_ & (kBufferRingEntries - 1));
+    buf->addr = reinterpret_cast<uint64_t>(bufBase_ + static_cast<size_t>(bufferId) * kBufferSize);
+    buf->len = kBufferSize;
+    buf->bid = static_cast<uint16_t>(bufferId);
+    ++bufTail_;
+}
+
+void IoUringPoller::publishBuffers()
+{
+    if (bufRing_) {
+        __atomic_store_n(&bufRing_->tail, bufTail_, __ATOMIC_RELEASE);
+    }
+}
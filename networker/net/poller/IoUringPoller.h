@@ -0,0 +1,204 @@
+#ifndef NETWORKER_NET_POLLER_IOURINGPOLLER_H
+#define NETWORKER_NET_POLLER_IOURINGPOLLER_H
+
+#include "networker/net/Poller.h"
+
+#include <stdint.h>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf_ring;
+
+namespace networker
+{
+namespace net
+{
+    /**
+     * IO Multiplexing with io_uring(7)
+     *
+     * 每个关注了事件的Channel在内核中有一个IORING_OP_POLL_ADD请求，触发后在下一次poll()时重新提交
+     * 一轮循环中的所有注册，修改，取消和等待都合并到一次io_uring_enter(2)中，而epoll每次修改都要一次epoll_ctl(2)
+     *
+     * 使用一次性(非multishot)的poll请求: multishot只在fd的等待队列被唤醒时产生完成事件，相当于边沿触发
+     * 而Channel的使用者依赖水平触发(例如一次没有读完的数据下一轮要继续通知)，一次性请求在提交时会先检查一次就绪状态
+     * 边沿触发的Channel(Channel::setEdgeTriggered)使用multishot请求(5.13)，触发后不需要重新提交，内核终止请求时(没有IORING_CQE_F_MORE)才重新提交
+     *
+     * 完成模式(Channel::setCompletionMode，6.0)，关注可读事件时直接提交请求，不再等待就绪:
+     *  kRecvCompletion: multishot recv，从provided buffer ring(所有Channel共用的kBufferRingEntries个kBufferSize字节的缓冲区)中取缓冲区
+     *      收到的数据留在缓冲区中，Channel处理可读事件时由takeReceived拷贝到Buffer并立即归还缓冲区
+     *  kAcceptCompletion: multishot accept
+     *  submitSend提交的IORING_OP_SENDMSG，完成后以可写事件通知
+     * 这样读写本身也合并到每轮一次的io_uring_enter中，不再各自一次系统调用
+     *
+     * 用户数据(user_data)的低32位是fd，接着3位是请求的类型，高29位是请求的序号，用序号识别已经取消或被替换的请求的过期完成事件
+     * 直接使用liburing之外的系统调用，不依赖liburing
+     */
+    class IoUringPoller: public Poller
+    {
+        private:
+            int ringFd_;
+
+            void* ringPtr_;         // SQ和CQ共用一次mmap(IORING_FEAT_SINGLE_MMAP)
+            size_t ringSize_;
+
+            unsigned* sqHead_;
+            unsigned* sqTail_;
+            unsigned* sqArray_;
+            unsigned sqMask_;
+            unsigned sqEntries_;
+            unsigned sqTailLocal_;  // 已经填好的SQE的尾部，提交前才写回sqTail_
+
+            struct io_uring_sqe* sqes_;
+            size_t sqesSize_;
+
+            unsigned* cqHead_;
+            unsigned* cqTail_;
+            unsigned cqMask_;
+            struct io_uring_cqe* cqes_;
+
+            // 一次发送的msghdr和iovec，在完成之前保持有效，用完放回sendRequests_
+            struct SendRequest;
+
+            // 一个fd上的请求和本轮收割到的结果
+            struct FdState
+            {
+                uint32_t baseSeq;       // 当前Channel注册时的序号，更早的请求属于之前使用这个fd的Channel
+                uint32_t pollSeq;       // POLL_ADD请求的序号，0表示没有
+                uint32_t recvSeq;       // multishot recv/accept请求的序号
+                uint32_t sendSeq;       // SENDMSG请求的序号
+                int revents;            // 一次收割中同一个fd的多个完成事件合并
+                int firstCompletion;    // completions_中还没有取走的第一个recv/accept结果，-1表示没有
+                int lastCompletion;
+                bool hasSendResult;
+                ssize_t sendResult;
+                SendRequest* send;      // 正在进行的发送
+            };
+
+            // 一个recv/accept完成事件，同一个fd的按到达顺序链接
+            struct Completion
+            {
+                int res;
+                int bufferId;           // 没有使用provided buffer时为-1
+                int next;
+                bool accepted;          // res是接受的连接
+            };
+
+            uint32_t nextSeq_;
+
+            std::vector<FdState> fds_;          // 以fd为下标
+
+            std::vector<int> rearmFds_;         // 上一轮请求结束了的fd，需要重新提交请求
+
+            std::vector<int> activeFds_;
+
+            std::vector<Completion> completions_;   // 本轮收割到的recv/accept结果
+
+            std::vector<int> completionFds_;    // completions_中有结果的fd
+
+            // provided buffer ring，第一个完成模式的recv请求提交前才创建
+            struct io_uring_buf_ring* bufRing_;
+            char* bufBase_;
+            size_t bufRingSize_;
+            uint16_t bufTail_;
+
+            std::vector<SendRequest*> sendRequests_;    // 空闲的SendRequest
+
+            // 本轮完成的发送的holder，在收割之后释放(可能析构TcpConnection)
+            std::vector<std::shared_ptr<const void>> releasedHolders_;
+
+        public:
+            static const unsigned kRingEntries = 256;
+
+            static const unsigned kBufferRingEntries = 256;
+            static const unsigned kBufferSize = 16 * 1024;
+
+            // 一次SENDMSG最多的iovec个数，多出的部分由下一次发送继续
+            static const int kMaxSendIovecs = 64;
+
+            // 内核是否支持本实现需要的io_uring特性，结果在进程内缓存
+            static bool isSupported();
+
+            // 内核是否支持multishot poll(5.13)，边沿触发的Channel需要它，结果在进程内缓存
+            static bool isMultishotPollSupported();
+
+            // 内核是否支持provided buffer ring(5.19)和multishot recv(6.0)，完成模式需要它们，结果在进程内缓存
+            static bool isCompletionIoSupported();
+
+            IoUringPoller(EventLoop *loop);
+
+            ~IoUringPoller() override;
+
+            Timestamp poll(int timeoutMs, ChannelList *activeChannels) override;
+
+            void updateChannel(Channel *channel) override;
+
+            void removeChannel(Channel *channel) override;
+
+            bool supportsEdgeTriggered() const override
+            {
+                return isMultishotPollSupported();
+            }
+
+            bool supportsCompletionIo() const override
+            {
+                return isCompletionIoSupported();
+            }
+
+            ssize_t takeReceived(Channel *channel, Buffer *buf, int *savedErrno) override;
+
+            int takeAccepted(Channel *channel, int *savedErrno) override;
+
+            void submitSend(Channel *channel, const struct iovec *iov, int iovcnt, std::shared_ptr<const void> holder) override;
+
+            bool takeSendResult(Channel *channel, ssize_t *result) override;
+
+        private:
+            struct io_uring_sqe* getSqe();
+
+            // 提交所有已经填好的SQE，并且(可选)等待完成事件
+            int enter(unsigned minComplete, unsigned flags, const void* arg, size_t argSize);
+
+            uint32_t nextSeq();
+
+            FdState& fdState(int fd);
+
+            // 按Channel关注的事件提交还没有的poll请求和recv/accept请求
+            void arm(Channel *channel);
+
+            void armPoll(Channel *channel, int events);
+
+            void armRecv(Channel *channel);
+
+            void cancelPoll(int fd);
+
+            void cancelRecv(int fd);
+
+            void cancelSend(int fd);
+
+            void rearm();
+
+            int fillActiveChannels(ChannelList *activeChannels);
+
+            void handleRecvCompletion(int fd, uint32_t seq, bool accept, const struct io_uring_cqe& cqe);
+
+            void handleSendCompletion(int fd, uint32_t seq, const struct io_uring_cqe& cqe);
+
+            void markActive(int fd, int revents);
+
+            // 释放fd上还没有取走的recv/accept结果: 归还缓冲区，关闭接受的连接
+            void discardCompletions(int fd);
+
+            void discardAllCompletions();
+
+            void setupBufferRing();
+
+            void recycleBuffer(int bufferId);
+
+            // 把归还的缓冲区交给内核
+            void publishBuffers();
+    };
+};
+};
+
+#endif
@@ -48,21 +48,22 @@ void PollPoller::fillActiveChannels(int numEvents, ChannelList *activeChannels)
         // pfd->revents > 0，一般包含, POLLIN, POLLPRI, POLLOUT, POLLRDHUP, POLLERR, POLLHUP
         if (pfd->revents > 0) {
             --numEvents;
-            ChannelMap::const_iterator ch = channels_.find(pfd->fd);
-            assert(ch != channels_.end());
 
             // 获取fd所对应的channel
-            Channel *channel = ch->second;
+            Channel *channel = findChannel(pfd->fd);
+            assert(channel != NULL);
             // 相互验证
             assert(channel->fd() == pfd->fd);
 
+            channel->set_revents(pfd->revents);
+
             // 把所得的channel加入到EventLoop 的activeChannels中
             activeChannels->push_back(channel);
         }
     }
 }
 
-// 新增或修改poll 事件。添加新Channel O(logN)，更新已有的ChannelO(1)
+// 新增或修改poll 事件。添加新Channel和更新已有的Channel都是O(1)
 void PollPoller::updateChannel(Channel *channel)
 {
     Poller::assertInLoopThread();
@@ -70,8 +71,6 @@ void PollPoller::updateChannel(Channel *channel)
 
     if (channel->index() < 0) {
         // 一个新的，添加到pollfds_
-        assert(channels_.find(channel->fd()) == channels_.end());
-
         struct pollfd pfd;
 
         // 设置多个pollfd的fd, events和revents
@@ -85,12 +84,11 @@ void PollPoller::updateChannel(Channel *channel)
         channel->set_index(idx);
         
         // 维护pfd.fd 和 channel 的映射关系 
-        channels_[pfd.fd] = channel;
+        insertChannel(channel);
 
     } else {
         // 更新现有的
-        assert(channels_.find(channel->fd()) != channels_.end());
-        assert(channels_[channel->fd()] == channel);
+        assert(findChannel(channel->fd()) == channel);
 
         int idx = channel->index();
         assert(0 <= idx && idx < static_cast<int>(pollfds_.size()));
@@ -114,8 +112,6 @@ void PollPoller::removeChannel(Channel *channel)
     Poller::assertInLoopThread();
     LOG_TRACE << "fd = " << channel->fd();
 
-    assert(channels_.find(channel->fd()) != channels_.end());
-    assert(channels_[channel->fd()] == channel);
     assert(channel->isNoneEvent());
 
     int idx = channel->index();
@@ -124,8 +120,7 @@ void PollPoller::removeChannel(Channel *channel)
     const struct pollfd& pfd = pollfds_[idx]; (void)pfd;
     assert(pfd.fd == -channel->fd()-1 && pfd.events == channel->events());
 
-    size_t n = channels_.erase(channel->fd());
-    assert(n == 1); (void)n;
+    eraseChannel(channel);
 
     if (implicit_cast<size_t>(idx) == pollfds_.size() - 1) {
         pollfds_.pop_back();
@@ -136,7 +131,7 @@ void PollPoller::removeChannel(Channel *channel)
             channelAtEnd = -channelAtEnd - 1;
         }
 
-        channels_[channelAtEnd]->set_index(idx);
+        findChannel(channelAtEnd)->set_index(idx);
         pollfds_.pop_back();
     }
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "networker/base/LogStream.h"
+#include "networker/base/Timestamp.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace networker;
+
+/**
+ * LogStream格式化double的正确性检查和微基准
+ *
+ * 先检查 LogStream<<double 与 "%.12g"、Fixed(v, p) 与 "%.*f" 的输出逐字节相同，Shortest能还原出原值
+ * 样本是特殊值、随机的位模式(覆盖次正规数、NaN、极大极小的指数)和常见的小数
+ * 再比较snprintf和这几种格式化的耗时
+ *
+ * double_bench [检查的样本数] [基准的迭代次数]
+ */
+
+namespace
+{
+    struct CheckResult
+    {
+        int64_t general;    // <<double 与 %.12g 不同
+        int64_t fixed;      // Fixed 与 %.*f 不同
+        int64_t shortest;   // Shortest 不能还原
+    };
+
+    double sample(std::mt19937_64& rng, int64_t i)
+    {
+        static const double kSpecial[] = {
+            0.0, -0.0, 1.0, 0.1, 0.3, 0.5, 2.5, -1.25, 1.005,
+            1e-300, 1e300, 5e-324, 1.7976931348623157e308,
+            123456789012.0, 1234567890123.0, NAN, INFINITY, -INFINITY,
+        };
+        const int64_t kNumSpecial = sizeof kSpecial / sizeof kSpecial[0];
+        if (i < kNumSpecial) {
+            return kSpecial[i];
+        }
+
+        uint64_t bits = rng();
+        double v;
+        if (i % 2) {
+            memcpy(&v, &bits, sizeof v);
+        } else {
+            v = static_cast<double>(bits % 100000000) / static_cast<double>(1 + rng() % 100000);
+        }
+        return v;
+    }
+
+    // 只打印前几个不同的样本
+    void report(int64_t* count, const char* what, const char* expected, const char* actual, int actualLen)
+    {
+        if (++*count <= 5) {
+            printf("mismatch %s: expected %s, got %.*s\n", what, expected, actualLen, actual);
+        }
+    }
+
+    CheckResult check(int64_t samples)
+    {
+        CheckResult result = {0, 0, 0};
+        std::mt19937_64 rng(42);
+        char expected[64];
+
+        for (int64_t i = 0; i < samples; ++i) {
+            double v = sample(rng, i);
+
+            LogStream stream;
+            stream << v;
+            int len = snprintf(expected, sizeof expected, "%.12g", v);
+            if (stream.buffer().length() != len || memcmp(expected, stream.buffer().data(), len) != 0) {
+                report(&result.general, "%.12g", expected, stream.buffer().data(), stream.buffer().length());
+            }
+
+            // 超出缓冲区的%.*f(很大的数)不比较
+            int precision = static_cast<int>(i % 10);
+            Fixed fixed(v, precision);
+            len = snprintf(expected, sizeof expected, "%.*f", precision, v);
+            if (len < static_cast<int>(sizeof expected) && (fixed.length() != len || memcmp(expected, fixed.data(), len) != 0)) {
+                char what[16];
+                snprintf(what, sizeof what, "%%.%df", precision);
+                report(&result.fixed, what, expected, fixed.data(), fixed.length());
+            }
+
+            if (isfinite(v)) {
+                Shortest shortest(v);
+                std::string str(shortest.data(), shortest.length());
+                if (strtod(str.c_str(), NULL) != v) {
+                    snprintf(expected, sizeof expected, "%.17g", v);
+                    report(&result.shortest, "shortest", expected, shortest.data(), shortest.length());
+                }
+            }
+        }
+        return result;
+    }
+
+    // 返回每次格式化的纳秒数
+    template<typename Format>
+    double bench(int iterations, Format format)
+    {
+        volatile int sink = 0;
+        Timestamp start(Timestamp::now());
+        for (int i = 0; i < iterations; ++i) {
+            sink = sink + format(0.123 + i * 1e-3);
+        }
+        return timeDifference(Timestamp::now(), start) * 1e9 / iterations;
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    const int64_t samples = argc > 1 ? atoll(argv[1]) : 2000000;
+    const int iterations = argc > 2 ? atoi(argv[2]) : 5000000;
+
+    CheckResult result = check(samples);
+    printf("checked %lld samples: %%.12g mismatches %lld, %%.*f mismatches %lld, shortest round-trip failures %lld\n",
+        static_cast<long long>(samples), static_cast<long long>(result.general),
+        static_cast<long long>(result.fixed), static_cast<long long>(result.shortest));
+
+    double snprintfNs = bench(iterations, [](double v) {
+        char buf[64];
+        return snprintf(buf, sizeof buf, "%.12g", v);
+    });
+    double streamNs = bench(iterations, [](double v) {
+        LogStream stream;
+        stream << v;
+        return stream.buffer().length();
+    });
+    double fixedNs = bench(iterations, [](double v) {
+        Fixed fixed(v, 3);
+        return fixed.length();
+    });
+    double shortestNs = bench(iterations, [](double v) {
+        Shortest shortest(v);
+        return shortest.length();
+    });
+    printf("ns per double: snprintf(%%.12g) %.1f  LogStream<< %.1f  Fixed(3) %.1f  Shortest %.1f\n",
+        snprintfNs, streamNs, fixedNs, shortestNs);
+
+    return result.general == 0 && result.fixed == 0 && result.shortest == 0 ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+#include "networker/net/http/HttpServer.h"
+#include "networker/net/http/HttpRequest.h"
+#include "networker/net/http/HttpResponse.h"
+#include "networker/net/EventLoop.h"
+#include "networker/net/InetAddress.h"
+#include "networker/base/Logging.h"
+#include "networker/base/Timestamp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace networker;
+using namespace networker::net;
+
+/**
+ * 类似wrk的HTTP压测: 每个连接一个客户端线程，保持连接，每次发送pipeline个GET请求，收齐响应后再发下一批
+ * 服务端是同一进程中的HttpServer，统计请求数和每批请求的延迟
+ *
+ * http_bench [连接数] [秒数] [pipeline] [服务端IO线程数] [et|uring]
+ * uring使用io_uring的完成模式收发(TcpServer::setCompletionIo)，需要同时设置环境变量NETWORKER_USE_IO_URING
+ */
+
+namespace
+{
+    const uint16_t kPort = 2008;
+
+    const char kRequest[] = "GET /bench HTTP/1.1\r\nHost: localhost\r\nUser-Agent: http_bench\r\n\r\n";
+
+    std::atomic<bool> g_running(true);
+
+    void onRequest(const HttpRequest&, HttpResponse* resp)
+    {
+        resp->setStatusCode(HttpResponse::k200Ok);
+        resp->setContentType("text/plain");
+        resp->setBody("hello, world!\n");
+    }
+
+    // 在buf[begin, end)中找一个完整的响应，返回它的结尾，不完整时返回NULL
+    const char* parseResponse(const char* begin, const char* end)
+    {
+        const char* headerEnd = static_cast<const char*>(memmem(begin, end - begin, "\r\n\r\n", 4));
+        if (headerEnd == NULL) {
+            return NULL;
+        }
+        const char* field = static_cast<const char*>(memmem(begin, headerEnd - begin, "Content-Length: ", 16));
+        size_t length = field != NULL ? strtoul(field + 16, NULL, 10) : 0;
+        const char* responseEnd = headerEnd + 4 + length;
+        return responseEnd <= end ? responseEnd : NULL;
+    }
+
+    struct ClientResult
+    {
+        int64_t requests;
+        int64_t errors;
+        std::vector<int64_t> latencyUs;
+    };
+
+    void runClient(int pipeline, ClientResult* result)
+    {
+        result->requests = 0;
+        result->errors = 0;
+
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof addr) < 0) {
+            perror("connect");
+            ++result->errors;
+            ::close(fd);
+            return;
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        std::string batch;
+        for (int i = 0; i < pipeline; ++i) {
+            batch.append(kRequest, sizeof(kRequest) - 1);
+        }
+
+        std::vector<char> buf(64 * 1024);
+        while (g_running.load(std::memory_order_relaxed)) {
+            Timestamp start(Timestamp::now());
+            if (::write(fd, batch.data(), batch.size()) != static_cast<ssize_t>(batch.size())) {
+                ++result->errors;
+                break;
+            }
+
+            int pending = pipeline;
+            size_t filled = 0;
+            while (pending > 0) {
+                if (filled == buf.size()) {
+                    buf.resize(buf.size() * 2);
+                }
+                ssize_t n = ::read(fd, buf.data() + filled, buf.size() - filled);
+                if (n <= 0) {
+                    ++result->errors;
+                    ::close(fd);
+                    return;
+                }
+                filled += n;
+
+                const char* p = buf.data();
+                const char* end = buf.data() + filled;
+                while (pending > 0) {
+                    const char* next = parseResponse(p, end);
+                    if (next == NULL) {
+                        break;
+                    }
+                    p = next;
+                    --pending;
+                }
+                filled = end - p;
+                memmove(buf.data(), p, filled);
+            }
+
+            result->requests += pipeline;
+            result->latencyUs.push_back(timeDifference(Timestamp::now(), start) * 1000 * 1000);
+        }
+        ::close(fd);
+    }
+
+    int64_t percentile(const std::vector<int64_t>& sorted, double q)
+    {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t i = std::min(sorted.size() - 1, static_cast<size_t>(q * static_cast<double>(sorted.size())));
+        return sorted[i];
+    }
+};
+
+int main(int argc, char* argv[])
+{
+    const int connections = argc > 1 ? atoi(argv[1]) : 32;
+    const int seconds = argc > 2 ? atoi(argv[2]) : 10;
+    const int pipeline = argc > 3 ? std::max(1, atoi(argv[3])) : 1;
+    const int ioThreads = argc > 4 ? atoi(argv[4]) : 4;
+    const bool edgeTriggered = argc > 5 && strcmp(argv[5], "et") == 0;
+    const bool completionIo = argc > 5 && strcmp(argv[5], "uring") == 0;
+
+    Logger::setLogLevel(Logger::WARN);
+
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(kPort), "HttpBench");
+    server.setHttpCallback(onRequest);
+    server.setThreadNum(ioThreads);
+    server.tcpServer()->setEdgeTriggered(edgeTriggered);
+    server.tcpServer()->setCompletionIo(completionIo);
+    server.start();
+
+    std::vector<ClientResult> results(connections);
+    std::vector<std::thread> clients;
+    std::thread driver([&]() {
+        for (int i = 0; i < connections; ++i) {
+            clients.emplace_back(runClient, pipeline, &results[i]);
+        }
+        ::sleep(seconds);
+        g_running = false;
+        for (std::thread& client: clients) {
+            client.join();
+        }
+        loop.quit();
+    });
+
+    loop.loop();
+    driver.join();
+
+    int64_t requests = 0;
+    int64_t errors = 0;
+    std::vector<int64_t> latency;
+    for (const ClientResult& result: results) {
+        requests += result.requests;
+        errors += result.errors;
+        latency.insert(latency.end(), result.latencyUs.begin(), result.latencyUs.end());
+    }
+    std::sort(latency.begin(), latency.end());
+
+    printf("%d connections, %d s, pipeline %d, %d io threads%s\n",
+        connections, seconds, pipeline, ioThreads,
+        edgeTriggered ? ", edge-triggered" : (completionIo ? ", completion I/O" : ""));
+    printf("requests/sec: %.0f  errors: %lld\n",
+        static_cast<double>(requests) / seconds, static_cast<long long>(errors));
+    printf("batch latency us: p50 %lld  p90 %lld  p99 %lld  max %lld\n",
+        static_cast<long long>(percentile(latency, 0.5)), static_cast<long long>(percentile(latency, 0.9)),
+        static_cast<long long>(percentile(latency, 0.99)), static_cast<long long>(latency.empty() ? 0 : latency.back()));
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+#include "networker/net/EventLoop.h"
+#include "networker/net/EventLoopThread.h"
+#include "networker/base/CountDownLatch.h"
+#include "networker/base/Timestamp.h"
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace networker;
+using namespace networker::net;
+
+/**
+ * 统计向EventLoop投递任务时的内存分配次数和吞吐
+ *
+ * 替换全局的operator new计数，多个生产者线程queueInLoop，任务捕获一个shared_ptr和两个整数(与TcpConnection投递的任务大小相当)
+ * 先预热一轮让MpscQueue的空闲结点达到峰值，第二轮统计每次投递的平均分配次数，期望为0
+ *
+ * post_bench [生产者线程数] [每个线程的投递次数]
+ */
+
+namespace
+{
+    std::atomic<int64_t> g_allocations(0);
+
+    // 最多有这么多任务已投递还没执行，使两轮的队列峰值长度相同，并且不超过MpscQueue保留的空闲结点数
+    const int64_t kWindow = 2048;
+
+    struct Counter
+    {
+        std::atomic<int64_t> done;
+        int64_t sum;
+    };
+
+    void produce(EventLoop* loop, const std::shared_ptr<Counter>& counter, int64_t begin, int64_t posts,
+        std::atomic<int64_t>* posted, CountDownLatch* latch)
+    {
+        for (int64_t i = 0; i < posts; ++i) {
+            int64_t n = posted->fetch_add(1, std::memory_order_relaxed) + 1;
+            while (n - counter->done.load(std::memory_order_acquire) > kWindow) {
+                std::this_thread::yield();
+            }
+            int64_t value = begin + i;
+            loop->queueInLoop([counter, value, n]() {
+                counter->sum += value ^ n;
+                counter->done.fetch_add(1, std::memory_order_release);
+            });
+        }
+        latch->countDown();
+    }
+
+    // 返回这一轮的内存分配次数，*seconds为投递并执行完所有任务的时间
+    int64_t runRound(EventLoop* loop, int producers, int64_t posts, double* seconds)
+    {
+        std::shared_ptr<Counter> counter(new Counter);
+        counter->done = 0;
+        counter->sum = 0;
+        std::atomic<int64_t> posted(0);
+        CountDownLatch latch(producers);
+
+        std::vector<std::thread> threads;
+        threads.reserve(producers);
+        int64_t allocationsBefore = g_allocations.load();
+        Timestamp start(Timestamp::now());
+        for (int i = 0; i < producers; ++i) {
+            threads.emplace_back(produce, loop, counter, i * posts, posts, &posted, &latch);
+        }
+        latch.wait();
+        while (counter->done.load(std::memory_order_acquire) < producers * posts) {
+            std::this_thread::yield();
+        }
+        *seconds = timeDifference(Timestamp::now(), start);
+        int64_t allocations = g_allocations.load() - allocationsBefore;
+
+        for (std::thread& thread: threads) {
+            thread.join();
+        }
+        // std::thread自身的分配(每个线程一次)
+        return allocations - producers;
+    }
+};
+
+void* operator new(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    const int producers = argc > 1 ? atoi(argv[1]) : 4;
+    const int64_t posts = argc > 2 ? atoll(argv[2]) : 1000000;
+
+    EventLoopThread loopThread;
+    EventLoop* loop = loopThread.startLoop();
+
+    double seconds = 0;
+    int64_t warmup = runRound(loop, producers, posts, &seconds);
+    printf("warm-up: %d producers x %lld posts, %lld allocations, %.0f posts/sec\n",
+        producers, static_cast<long long>(posts), static_cast<long long>(warmup), producers * posts / seconds);
+
+    int64_t allocations = runRound(loop, producers, posts, &seconds);
+    printf("steady:  %d producers x %lld posts, %lld allocations (%.6f per post), %.0f posts/sec\n",
+        producers, static_cast<long long>(posts), static_cast<long long>(allocations),
+        static_cast<double>(allocations) / static_cast<double>(producers * posts), producers * posts / seconds);
+    return 0;
+}